@@ -0,0 +1,186 @@
+#include <Benchmarks/FrameBenchmark.hpp>
+
+#include <Benchmarks/TerrainBenchmarks.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace fluorite
+{
+
+    void FrameBenchmark::loadTerrain(Ogre3d& ogre3d, TerrainDataBlockStorage& storage, TerrainMeshingService& service, std::set<Vec3Int>& meshed, int sizeInBlocks) {
+        for(int x = 0; x < sizeInBlocks; x++) {
+            for(int z = 0; z < sizeInBlocks; z++) {
+                for(int y = -1; y < 1; y++) {
+                    auto blockPos = Vec3Int(x, y, z).mul(TerrainDataBlock::getBlockSize());
+                    service.submit(storage.requestBlock(blockPos), 1, 0);
+                    meshed.insert(blockPos);
+                }
+            }
+        }
+        service.waitIdle();
+
+        //Meshes go through the upload queue, so first frames include the upload cost as they would in game
+        for(auto& mesh : service.takeCompleted()) {
+            ogre3d.queueTerrainMesh(std::move(mesh));
+        }
+    }
+
+    int FrameBenchmark::streamTerrain(Ogre3d& ogre3d, TerrainDataBlockStorage& storage, TerrainMeshingService& service, TerrainPrefetchScheduler* prefetch,
+        std::set<Vec3Int>& meshed, float demandRadius) {
+        auto blockSize = TerrainDataBlock::getBlockSize();
+        auto halfBlock = Ogre::Vector3(blockSize * 0.5f);
+        auto pos = ogre3d.getCamera()->getPos();
+
+        int streamed = 0;
+        auto lo = Vec3Int(std::floor(pos.x - demandRadius), std::floor(pos.y - demandRadius), std::floor(pos.z - demandRadius)).align(blockSize);
+        auto hi = Vec3Int(std::ceil(pos.x + demandRadius), std::ceil(pos.y + demandRadius), std::ceil(pos.z + demandRadius));
+        for(int x = lo.x; x <= hi.x; x += blockSize) {
+            for(int y = lo.y; y <= hi.y; y += blockSize) {
+                for(int z = lo.z; z <= hi.z; z += blockSize) {
+                    auto blockPos = Vec3Int(x, y, z);
+                    auto distance = (OgreVecFromV3I(blockPos) + halfBlock).distance(pos);
+                    if(distance > demandRadius) {
+                        continue;
+                    }
+                    //Prefetched blocks only have data, they are meshed once requested
+                    auto block = storage.requestBlock(blockPos);
+                    if(meshed.insert(blockPos).second) {
+                        service.submit(block, 1, distance);
+                        streamed++;
+                    }
+                }
+            }
+        }
+
+        //Regular requests come first, so the scheduler skips what they already cover
+        if(prefetch) {
+            prefetch->update(pos, ogre3d.getCamera()->getVelocity());
+        }
+
+        for(auto& mesh : service.takeCompleted()) {
+            ogre3d.queueTerrainMesh(std::move(mesh));
+        }
+        return streamed;
+    }
+
+    void FrameBenchmark::editTerrain(Ogre3d& ogre3d, TerrainEditor& editor, TerrainMeshingService& service, float t, int sizeInBlocks) {
+        auto extent = (float)(sizeInBlocks * TerrainDataBlock::getBlockSize());
+        editor.apply(TerrainEditBrush::sphere(Ogre::Vector3(extent * t, 0, extent * 0.5f), 4, TerrainEditBrush::SUBTRACT));
+        auto edited = editor.submitRemeshes(service, ogre3d.getCamera()->getPos());
+
+        //Waiting here makes the edit part of this frame, as it would be for the player who made it.
+        //Streamed meshes finished meanwhile keep their place in the budget
+        service.waitIdle();
+        for(auto& mesh : service.takeCompleted()) {
+            auto priority = edited.count({mesh.lod, mesh.blockPos}) ? TerrainUploadQueue::EDIT : TerrainUploadQueue::STREAMED;
+            ogre3d.queueTerrainMesh(std::move(mesh), priority);
+        }
+    }
+
+    void FrameBenchmark::placeCamera(Ogre3d& ogre3d, float t, int sizeInBlocks) {
+        auto extent = (float)(sizeInBlocks * TerrainDataBlock::getBlockSize());
+        auto center = Ogre::Vector3(extent * 0.5f, 0, extent * 0.5f);
+        auto angle = t * Ogre::Math::TWO_PI;
+        auto offset = Ogre::Vector3(std::cos(angle), 0, std::sin(angle)) * extent * 0.6f + Ogre::Vector3(0, extent * 0.25f, 0);
+        ogre3d.getCamera()->setPos(center + offset).lookAt(center);
+    }
+
+    void FrameBenchmark::printSummary(const std::string& name, std::vector<double> seconds) {
+        std::sort(seconds.begin(), seconds.end());
+        auto at = [&](double fraction) {
+            return seconds[std::min(seconds.size() - 1, (size_t)(fraction * seconds.size()))] * 1000;
+        };
+        double sum = 0;
+        for(auto value : seconds) {
+            sum += value;
+        }
+        std::cout << name << " ms mean: " << std::fixed << std::setprecision(3) << sum / seconds.size() * 1000
+            << " p50: " << at(0.5) << " p95: " << at(0.95) << " p99: " << at(0.99) << " max: " << seconds.back() * 1000 << '\n';
+    }
+
+    int FrameBenchmark::run(const Settings& settings) {
+        auto ogre3d = Ogre3d();
+        if(!ogre3d.initOgreHeadless(settings.width, settings.height)) {
+            std::cerr << "Headless rendering couldn't be initialized\n";
+            return 1;
+        }
+        auto storage = TerrainDataBlockStorage(TerrainBenchmarks::hills);
+        auto service = TerrainMeshingService();
+        service.setOccluderExtraction(4);
+        auto editor = TerrainEditor(&storage);
+        auto prefetch = TerrainPrefetchScheduler(&storage);
+        std::set<Vec3Int> meshed;
+        loadTerrain(ogre3d, storage, service, meshed, settings.sizeInBlocks);
+
+        std::ofstream csv;
+        if(!settings.outputDirectory.empty()) {
+            std::filesystem::create_directories(settings.outputDirectory);
+            csv.open(settings.outputDirectory + "/frames.csv");
+            csv << "frame,cpu_ms,scene_ms,render_ms\n";
+        }
+
+        std::vector<double> cpu, scene, render, total, edit;
+        int64_t occludedRegions = 0;
+        int streamedBlocks = 0;
+        const float delta = 1.0f / 60;
+        for(int frame = 0; frame < settings.frames; frame++) {
+            placeCamera(ogre3d, (float)frame / settings.frames, settings.sizeInBlocks);
+            streamedBlocks += streamTerrain(ogre3d, storage, service, settings.prefetch ? &prefetch : nullptr, meshed, TerrainPrefetchScheduler::Settings().demandRadius);
+            if(settings.editEvery > 0 && frame % settings.editEvery == 0) {
+                auto start = std::chrono::high_resolution_clock::now();
+                editTerrain(ogre3d, editor, service, (float)frame / settings.frames, settings.sizeInBlocks);
+                edit.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+            }
+            ogre3d.ogreFrame(delta);
+
+            auto timings = ogre3d.getLastFrameTimings();
+            cpu.push_back(timings.cpuSeconds);
+            scene.push_back(timings.sceneUpdateSeconds);
+            render.push_back(timings.renderSeconds);
+            total.push_back(timings.cpuSeconds + timings.renderSeconds);
+            occludedRegions += ogre3d.getTerrainBatcher()->getStats().occludedRegions;
+            if(csv) {
+                csv << frame << ',' << timings.cpuSeconds * 1000 << ',' << timings.sceneUpdateSeconds * 1000 << ',' << timings.renderSeconds * 1000 << '\n';
+            }
+
+            if(!settings.outputDirectory.empty() && settings.dumpEvery > 0 && frame % settings.dumpEvery == 0) {
+                std::stringstream path;
+                path << settings.outputDirectory << "/frame_" << std::setw(5) << std::setfill('0') << frame << ".ppm";
+                if(!ogre3d.saveFrame(path.str())) {
+                    std::cerr << "Couldn't write " << path.str() << '\n';
+                }
+            }
+        }
+        ogre3d.ogreShutdown();
+
+        std::cout << "frames: " << settings.frames << " resolution: " << settings.width << "x" << settings.height << '\n';
+        printSummary("cpu", cpu);
+        printSummary("scene update", scene);
+        printSummary("render", render);
+        printSummary("frame", total);
+        if(!edit.empty()) {
+            printSummary("edit remesh", edit);
+        }
+        std::cout << "occluded regions per frame: " << std::fixed << std::setprecision(2) << (double)occludedRegions / settings.frames << '\n';
+        auto prefetchStats = prefetch.getStats();
+        std::cout << "streamed blocks: " << streamedBlocks << " prefetched: " << prefetchStats.storage.prefetched << " cancelled: " << prefetchStats.cancelled
+            << " hit rate: " << std::setprecision(3) << prefetchStats.storage.hitRate() << '\n';
+        return 0;
+    }
+
+    bool FrameBenchmark::run(std::string name, std::string directory, int& exitCode) {
+        if(name == "--benchmark-frames") {
+            auto settings = Settings();
+            settings.outputDirectory = directory;
+            exitCode = run(settings);
+            return true;
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <SystemServices/Ogre3d/Ogre3d.hpp>
+#include <Terrain/TerrainEditor/TerrainEditor.hpp>
+#include <Terrain/TerrainPrefetch/TerrainPrefetch.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * Unattended rendering runs. A patch of terrain is rendered offscreen(Ogre3d::initOgreHeadless) along a scripted
+     * camera path with a fixed time step, so runs are repeatable on machines without a screen, e.g. Mesa software GL
+     * on CI. Blocks around the camera are streamed in as it moves, with prefetching ahead of it. A trench is dug across
+     * the patch meanwhile, edits are remeshed and shown on the frame they are made. Prints CPU, render and edit time
+     * percentiles and prefetch hit rate, optionally writes per-frame timings and frame images
+     */
+    class FrameBenchmark {
+        public:
+            struct Settings {
+                int width = 800;
+                int height = 600;
+                int frames = 600;
+                //Terrain patch is sizeInBlocks x sizeInBlocks blocks
+                int sizeInBlocks = 8;
+                //frames.csv and every dumpEvery-th frame as PPM are written here, nothing is written when empty
+                std::string outputDirectory;
+                int dumpEvery = 60;
+                //Frames between two brush strokes, 0 turns editing off
+                int editEvery = 10;
+                //Blocks ahead of the camera are generated by TerrainPrefetchScheduler before they are requested
+                bool prefetch = true;
+            };
+
+        private:
+            static void loadTerrain(Ogre3d& ogre3d, TerrainDataBlockStorage& storage, TerrainMeshingService& service, std::set<Vec3Int>& meshed, int sizeInBlocks);
+
+            /**
+             * Requests blocks within demandRadius of the camera, meshes those not meshed yet and queues finished meshes
+             * @param prefetch fed with the camera velocity when not null
+             * @return number of newly meshed blocks
+             */
+            static int streamTerrain(Ogre3d& ogre3d, TerrainDataBlockStorage& storage, TerrainMeshingService& service, TerrainPrefetchScheduler* prefetch,
+                std::set<Vec3Int>& meshed, float demandRadius);
+
+            /**
+             * Digs at point t from 0 to 1 along the trench and queues the remeshed blocks
+             */
+            static void editTerrain(Ogre3d& ogre3d, TerrainEditor& editor, TerrainMeshingService& service, float t, int sizeInBlocks);
+
+            /**
+             * Orbit around the middle of the patch, t from 0 to 1 is one full circle
+             */
+            static void placeCamera(Ogre3d& ogre3d, float t, int sizeInBlocks);
+
+            static void printSummary(const std::string& name, std::vector<double> seconds);
+
+        public:
+            static int run(const Settings& settings);
+
+            /**
+             * Runs mode named by command line argument, --benchmark-frames
+             * @param directory output directory, nothing is written when empty
+             * @return false if there is no such mode
+             */
+            static bool run(std::string name, std::string directory, int& exitCode);
+    };
+
+}
@@ -0,0 +1,333 @@
+#include <Benchmarks/PolygonizerRegression.hpp>
+
+#include <misc/AllocationCounter.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace fluorite
+{
+
+    //Deterministic value noise in -1..1, lattice every 4 voxels
+    static float valueNoise(Vec3Int p) {
+        auto lattice = [](int x, int y, int z) {
+            uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u;
+            h ^= h >> 13;
+            h *= 0x5bd1e995u;
+            h ^= h >> 15;
+            return (float)(h & 0xFFFF) / 32767.5f - 1.0f;
+        };
+        int x0 = div_floor(p.x, 4), y0 = div_floor(p.y, 4), z0 = div_floor(p.z, 4);
+        float fx = (p.x - x0 * 4) / 4.0f, fy = (p.y - y0 * 4) / 4.0f, fz = (p.z - z0 * 4) / 4.0f;
+        float result = 0;
+        for (int i = 0; i < 8; i++) {
+            float w = ((i & 1) ? fx : 1 - fx) * ((i & 2) ? fy : 1 - fy) * ((i & 4) ? fz : 1 - fz);
+            result += w * lattice(x0 + (i & 1), y0 + ((i >> 1) & 1), z0 + ((i >> 2) & 1));
+        }
+        return result;
+    }
+
+    std::vector<PolygonizerRegression::Field> PolygonizerRegression::createFields() {
+        std::vector<Field> fields;
+
+        fields.push_back({"plane", [](Vec3Int p) {
+            return TerrainDataBlockNode(std::clamp((int)((0.5f + 0.3f * p.x + 0.15f * p.z - p.y) * 8), -127, 127));
+        }, {Vec3Int(0, 0, 0)}, 1, {}});
+
+        fields.push_back({"sphere", [](Vec3Int p) {
+            auto distance = std::sqrt((p.x - 8.4f) * (p.x - 8.4f) + (p.y - 7.7f) * (p.y - 7.7f) + (p.z - 8.9f) * (p.z - 8.9f));
+            return TerrainDataBlockNode(std::clamp((int)((5.3f - distance) * 16), -127, 127));
+        }, {Vec3Int(0, 0, 0)}, 1, {}});
+
+        auto noise = [](Vec3Int p) {
+            return TerrainDataBlockNode(std::clamp((int)(valueNoise(p) * 100), -127, 127));
+        };
+        fields.push_back({"noise", noise, {Vec3Int(0, 0, 0), Vec3Int(16, 0, 0)}, 1, {}});
+
+        //Sphere crossing all faces of a LoD 2 block, with coarser neighbours on all faces
+        fields.push_back({"transitions", [](Vec3Int p) {
+            auto distance = std::sqrt((p.x - 16.3f) * (p.x - 16.3f) + (p.y - 15.8f) * (p.y - 15.8f) + (p.z - 16.6f) * (p.z - 16.6f));
+            return TerrainDataBlockNode(std::clamp((int)((19.2f - distance) * 8), -127, 127));
+        }, {Vec3Int(0, 0, 0)}, 2, {3, 3, 3, 3, 3, 3}});
+
+        //Block n along x has a single cell of case n in air, corners are numbered as in TransvoxelPolygonizator
+        std::vector<Vec3Int> caseBlocks;
+        for (int i = 0; i < 256; i++) {
+            caseBlocks.push_back(Vec3Int(i * 16, 0, 0));
+        }
+        fields.push_back({"cases", [](Vec3Int p) {
+            int block = div_floor(p.x, 16);
+            int x = p.x - block * 16 - 4, y = p.y - 4, z = p.z - 4;
+            bool inCell = block >= 0 && block < 256 && x >= 0 && x <= 1 && y >= 0 && y <= 1 && z >= 0 && z <= 1;
+            bool solid = inCell && (block & (1 << (x | (z << 1) | (y << 2)))) != 0;
+            return TerrainDataBlockNode(solid ? 90 : -30);
+        }, caseBlocks, 1, {}});
+
+        return fields;
+    }
+
+    std::vector<PolygonizerRegression::Mesh> PolygonizerRegression::polygonize(const Field& field) {
+        auto storage = TerrainDataBlockStorage(field.density);
+        auto polygonizator = std::make_unique<TransvoxelPolygonizator>();
+        std::vector<Mesh> meshes;
+        for (auto& pos : field.blocks) {
+            auto block = storage.requestBlock(pos, field.lod);
+            polygonizator->clear();
+            polygonizator->PolygonizeSingleBlock(block.get(), field.lod, field.neighbourLods);
+            meshes.push_back({polygonizator->getVertices(), polygonizator->getIndices()});
+        }
+        return meshes;
+    }
+
+    void PolygonizerRegression::measure(const Field& field) {
+        auto storage = TerrainDataBlockStorage(field.density);
+        std::vector<std::shared_ptr<TerrainDataBlock>> blocks;
+        for (auto& pos : field.blocks) {
+            blocks.push_back(storage.requestBlock(pos, field.lod));
+        }
+
+        auto polygonizator = std::make_unique<TransvoxelPolygonizator>();
+        //Warm-up pass lets vertex and index buffers reach their final capacity
+        for (auto& block : blocks) {
+            polygonizator->clear();
+            polygonizator->PolygonizeSingleBlock(block.get(), field.lod, field.neighbourLods);
+        }
+
+        const int runs = 5;
+        auto allocationsBefore = AllocationCounter::getAllocations();
+        double bestSeconds = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; run++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (auto& block : blocks) {
+                polygonizator->clear();
+                polygonizator->PolygonizeSingleBlock(block.get(), field.lod, field.neighbourLods);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(end - start).count());
+        }
+        auto allocations = AllocationCounter::getAllocations() - allocationsBefore;
+
+        auto blockSize = TerrainDataBlock::getBlockSize();
+        auto cells = (double)blocks.size() * blockSize * blockSize * blockSize;
+        std::cout << "    cells/s: " << std::fixed << std::setprecision(0) << cells / bestSeconds;
+        if (AllocationCounter::isEnabled()) {
+            std::cout << " allocations per block: " << std::setprecision(2) << (double)allocations / (runs * blocks.size());
+        }
+        std::cout << '\n';
+    }
+
+    bool PolygonizerRegression::save(const std::string& path, const std::vector<Mesh>& meshes) {
+        std::ofstream file(path);
+        if (!file) {
+            return false;
+        }
+        file << std::setprecision(9);
+        file << "meshes " << meshes.size() << '\n';
+        for (auto& mesh : meshes) {
+            file << "mesh " << mesh.vertices.size() << ' ' << mesh.indices.size() / 3 << '\n';
+            for (auto& vertex : mesh.vertices) {
+                file << vertex.pos.x << ' ' << vertex.pos.y << ' ' << vertex.pos.z << ' '
+                    << vertex.normal.x << ' ' << vertex.normal.y << ' ' << vertex.normal.z << '\n';
+            }
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                file << mesh.indices[i] << ' ' << mesh.indices[i + 1] << ' ' << mesh.indices[i + 2] << '\n';
+            }
+        }
+        return (bool)file;
+    }
+
+    bool PolygonizerRegression::load(const std::string& path, std::vector<Mesh>& meshes) {
+        std::ifstream file(path);
+        std::string tag;
+        size_t count = 0;
+        if (!(file >> tag >> count) || tag != "meshes") {
+            return false;
+        }
+        meshes.resize(count);
+        for (auto& mesh : meshes) {
+            size_t vertices = 0, triangles = 0;
+            if (!(file >> tag >> vertices >> triangles) || tag != "mesh") {
+                return false;
+            }
+            for (size_t i = 0; i < vertices; i++) {
+                Ogre::Vector3 pos, normal;
+                file >> pos.x >> pos.y >> pos.z >> normal.x >> normal.y >> normal.z;
+                mesh.vertices.emplace_back(pos, normal);
+            }
+            mesh.indices.resize(triangles * 3);
+            for (auto& index : mesh.indices) {
+                file >> index;
+            }
+        }
+        return (bool)file;
+    }
+
+    std::string PolygonizerRegression::compare(const Mesh& golden, const Mesh& mesh) {
+        const float positionTolerance = 1e-3f;
+        const float normalTolerance = 1e-3f;
+
+        auto countEdges = [](const Mesh& mesh, size_t& openEdges) {
+            std::map<std::pair<int, int>, int> edges;
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                for (int e = 0; e < 3; e++) {
+                    auto a = mesh.indices[i + e];
+                    auto b = mesh.indices[i + (e + 1) % 3];
+                    edges[{std::min(a, b), std::max(a, b)}]++;
+                }
+            }
+            openEdges = std::count_if(edges.begin(), edges.end(), [](auto& edge) { return edge.second == 1; });
+            return edges.size();
+        };
+
+        std::ostringstream difference;
+        size_t goldenOpen, meshOpen;
+        auto goldenEdges = countEdges(golden, goldenOpen);
+        auto meshEdges = countEdges(mesh, meshOpen);
+        if (golden.vertices.size() != mesh.vertices.size() || golden.indices.size() != mesh.indices.size()
+            || goldenEdges != meshEdges || goldenOpen != meshOpen) {
+            difference << "topology differs, vertices " << mesh.vertices.size() << " (golden " << golden.vertices.size() << ")"
+                << " triangles " << mesh.indices.size() / 3 << " (" << golden.indices.size() / 3 << ")"
+                << " edges " << meshEdges << " (" << goldenEdges << ")"
+                << " open edges " << meshOpen << " (" << goldenOpen << ")";
+            return difference.str();
+        }
+
+        auto corner = [](const Mesh& mesh, size_t triangle, int k) -> const TransvoxelPolygonizatorVertex& {
+            return mesh.vertices[mesh.indices[triangle * 3 + k]];
+        };
+        auto centroidCell = [&](const Mesh& mesh, size_t triangle) {
+            auto centroid = (corner(mesh, triangle, 0).pos + corner(mesh, triangle, 1).pos + corner(mesh, triangle, 2).pos) / 3.0f;
+            return std::make_tuple((int)std::floor(centroid.x), (int)std::floor(centroid.y), (int)std::floor(centroid.z));
+        };
+        auto sameVertex = [&](const TransvoxelPolygonizatorVertex& a, const TransvoxelPolygonizatorVertex& b) {
+            auto delta = a.pos - b.pos;
+            if (std::abs(delta.x) > positionTolerance || std::abs(delta.y) > positionTolerance || std::abs(delta.z) > positionTolerance) {
+                return false;
+            }
+            auto lengthA = a.normal.length();
+            auto lengthB = b.normal.length();
+            if (lengthA < 1e-6f || lengthB < 1e-6f) {
+                return lengthA < 1e-6f && lengthB < 1e-6f;
+            }
+            return a.normal.dotProduct(b.normal) / (lengthA * lengthB) >= 1.0f - normalTolerance;
+        };
+
+        //Golden triangles bucketed by centroid, a triangle is searched in its cell and all neighbouring ones
+        std::map<std::tuple<int, int, int>, std::vector<size_t>> buckets;
+        auto triangles = golden.indices.size() / 3;
+        for (size_t t = 0; t < triangles; t++) {
+            buckets[centroidCell(golden, t)].push_back(t);
+        }
+        std::vector<bool> matched(triangles, false);
+
+        for (size_t t = 0; t < triangles; t++) {
+            auto [cx, cy, cz] = centroidCell(mesh, t);
+            bool found = false;
+            for (int n = 0; n < 27 && !found; n++) {
+                auto bucket = buckets.find({cx + n % 3 - 1, cy + n / 3 % 3 - 1, cz + n / 9 - 1});
+                if (bucket == buckets.end()) {
+                    continue;
+                }
+                for (auto candidate : bucket->second) {
+                    if (matched[candidate]) {
+                        continue;
+                    }
+                    //Any rotation of the corners, winding must stay the same
+                    for (int rotation = 0; rotation < 3 && !found; rotation++) {
+                        found = sameVertex(corner(golden, candidate, 0), corner(mesh, t, rotation))
+                            && sameVertex(corner(golden, candidate, 1), corner(mesh, t, (rotation + 1) % 3))
+                            && sameVertex(corner(golden, candidate, 2), corner(mesh, t, (rotation + 2) % 3));
+                    }
+                    if (found) {
+                        matched[candidate] = true;
+                        break;
+                    }
+                }
+            }
+            if (!found) {
+                auto& a = corner(mesh, t, 0).pos;
+                difference << "triangle " << t << " at " << a.x << ' ' << a.y << ' ' << a.z << " has no golden counterpart";
+                return difference.str();
+            }
+        }
+        return "";
+    }
+
+    int PolygonizerRegression::record(const std::string& directory) {
+        auto defaultSize = TerrainDataBlock::getBlockSize();
+        TerrainDataBlock::setBlockSize(16);
+        std::filesystem::create_directories(directory);
+
+        int exitCode = 0;
+        for (auto& field : createFields()) {
+            auto path = directory + "/" + field.name + ".mesh";
+            if (save(path, polygonize(field))) {
+                std::cout << field.name << ": recorded " << path << '\n';
+            } else {
+                std::cout << field.name << ": can't write " << path << '\n';
+                exitCode = 1;
+            }
+        }
+        TerrainDataBlock::setBlockSize(defaultSize);
+        return exitCode;
+    }
+
+    int PolygonizerRegression::check(const std::string& directory) {
+        auto defaultSize = TerrainDataBlock::getBlockSize();
+        TerrainDataBlock::setBlockSize(16);
+
+        int failed = 0;
+        for (auto& field : createFields()) {
+            std::vector<Mesh> golden;
+            if (!load(directory + "/" + field.name + ".mesh", golden)) {
+                std::cout << field.name << ": FAILED, can't read golden meshes from " << directory << '\n';
+                failed++;
+                continue;
+            }
+
+            auto meshes = polygonize(field);
+            std::string difference;
+            size_t triangles = 0;
+            if (golden.size() != meshes.size()) {
+                difference = "number of blocks differs";
+            }
+            for (size_t i = 0; i < meshes.size() && difference.empty(); i++) {
+                difference = compare(golden[i], meshes[i]);
+                if (!difference.empty()) {
+                    difference = "block " + std::to_string(i) + ": " + difference;
+                }
+                triangles += meshes[i].indices.size() / 3;
+            }
+
+            if (difference.empty()) {
+                std::cout << field.name << ": ok, blocks: " << meshes.size() << " triangles: " << triangles << '\n';
+            } else {
+                std::cout << field.name << ": FAILED, " << difference << '\n';
+                failed++;
+            }
+            measure(field);
+        }
+        TerrainDataBlock::setBlockSize(defaultSize);
+
+        std::cout << (failed == 0 ? "all fields match" : std::to_string(failed) + " fields differ") << '\n';
+        return failed == 0 ? 0 : 1;
+    }
+
+    bool PolygonizerRegression::run(std::string name, std::string directory, int& exitCode) {
+        if (directory.empty()) {
+            directory = defaultDirectory;
+        }
+        if (name == "--polygonizer-check") {
+            exitCode = check(directory);
+            return true;
+        }
+        if (name == "--polygonizer-record") {
+            exitCode = record(directory);
+            return true;
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * Golden mesh checks of TransvoxelPolygonizator. Canned density fields(plane, sphere, noise, transition cells and
+     * every one of the 256 cell cases) are polygonized and compared with meshes recorded earlier. Comparison ignores
+     * vertex and triangle order: topology(vertex, triangle, edge and open edge counts) must match exactly, positions and
+     * normals within a tolerance. Also prints cells per second and heap allocations per block of every field, so
+     * optimizations can be checked for both correctness and speed. Golden meshes are recorded with 16^3 blocks
+     */
+    class PolygonizerRegression {
+        public:
+            static constexpr const char* defaultDirectory = "data/polygonizer-golden";
+
+        private:
+            struct Field {
+                std::string name;
+                TerrainDensityFunction density;
+                std::vector<Vec3Int> blocks;
+                int lod = 1;
+                std::vector<int> neighbourLods;
+            };
+
+            struct Mesh {
+                std::vector<TransvoxelPolygonizatorVertex> vertices;
+                std::vector<int> indices;
+            };
+
+            static std::vector<Field> createFields();
+            static std::vector<Mesh> polygonize(const Field& field);
+            static void measure(const Field& field);
+
+            static bool save(const std::string& path, const std::vector<Mesh>& meshes);
+            static bool load(const std::string& path, std::vector<Mesh>& meshes);
+
+            /**
+             * @return empty string if meshes match, description of the first difference otherwise
+             */
+            static std::string compare(const Mesh& golden, const Mesh& mesh);
+
+        public:
+            /**
+             * Polygonizes all fields and overwrites golden meshes in directory
+             */
+            static int record(const std::string& directory);
+
+            /**
+             * Polygonizes all fields and compares them with golden meshes in directory
+             * @return 0 when all fields match
+             */
+            static int check(const std::string& directory);
+
+            /**
+             * Runs mode named by command line argument, --polygonizer-check or --polygonizer-record
+             * @param directory golden meshes, defaultDirectory when empty
+             * @return false if there is no such mode
+             */
+            static bool run(std::string name, std::string directory, int& exitCode);
+    };
+
+}
@@ -0,0 +1,236 @@
+#include <Benchmarks/TerrainBenchmarks.hpp>
+
+#include <Terrain/TerrainMeshing/TerrainMeshing.hpp>
+#include <misc/AllocationCounter.hpp>
+#include <chrono>
+#include <iomanip>
+
+namespace fluorite
+{
+
+    TerrainDataBlockNode TerrainBenchmarks::hills(Vec3Int p) {
+        auto height = 6 * std::sin(p.x * 0.1) + 4 * std::cos(p.z * 0.13);
+        return TerrainDataBlockNode(std::clamp((int)((height - p.y) * 4), -127, 127));
+    }
+
+    std::vector<std::shared_ptr<TerrainDataBlock>> TerrainBenchmarks::createBlocks(TerrainDataBlockStorage& storage, int sizeInBlocks) {
+        std::vector<std::shared_ptr<TerrainDataBlock>> blocks;
+        for(int x = 0; x < sizeInBlocks; x++) {
+            for(int z = 0; z < sizeInBlocks; z++) {
+                for(int y = -1; y < 1; y++) {
+                    blocks.push_back(storage.requestBlock(Vec3Int(x, y, z) * TerrainDataBlock::getBlockSize()));
+                }
+            }
+        }
+        return blocks;
+    }
+
+    int TerrainBenchmarks::meshing() {
+        auto storage = TerrainDataBlockStorage(hills);
+        auto blocks = createBlocks(storage, 16);
+
+        int maxThreads = std::max<int>(1, std::thread::hardware_concurrency());
+        for(int threads = 1; threads <= maxThreads; threads *= 2) {
+            auto blocksPerSecond = TerrainMeshingService::measureThroughput(blocks, 1, threads);
+            std::cout << "threads: " << threads << " blocks/s: " << std::fixed << std::setprecision(1) << blocksPerSecond << '\n';
+        }
+        return 0;
+    }
+
+    int TerrainBenchmarks::meshCache() {
+        auto storage = TerrainDataBlockStorage(hills);
+        auto blocks = createBlocks(storage, 16);
+        auto cache = TerrainMeshCache();
+        auto service = TerrainMeshingService(1);
+        service.setMeshCache(&cache);
+
+        //First pass meets every block for the first time, second one revisits them
+        for(int pass = 0; pass < 2; pass++) {
+            auto statsBefore = cache.getStats();
+            auto start = std::chrono::high_resolution_clock::now();
+            for(auto& block : blocks) {
+                service.submit(block, 1, 0);
+            }
+            service.waitIdle();
+            auto end = std::chrono::high_resolution_clock::now();
+            service.takeCompleted();
+
+            auto stats = cache.getStats();
+            auto hits = stats.hits - statsBefore.hits;
+            auto lookups = hits + stats.misses - statsBefore.misses;
+            std::cout << (pass == 0 ? "cold" : "warm") << " blocks/s: " << std::fixed << std::setprecision(1) << blocks.size() / std::chrono::duration<double>(end - start).count()
+                << " hit rate: " << std::setprecision(3) << (double)hits / lookups << '\n';
+        }
+        auto stats = cache.getStats();
+        std::cout << "cached meshes: " << stats.entries << " bytes: " << stats.bytes << '\n';
+        return 0;
+    }
+
+    int TerrainBenchmarks::polygonizer() {
+        auto storage = TerrainDataBlockStorage(hills);
+        auto blocks = createBlocks(storage, 16);
+        auto blockSize = TerrainDataBlock::getBlockSize();
+
+        auto liveBefore = AllocationCounter::getLiveAllocations();
+        int64_t allocationsInRun = 0;
+        double seconds = 0;
+        {
+            auto polygonizator = std::make_unique<TransvoxelPolygonizator>();
+
+            //Warm-up pass lets vertex and index buffers reach their final capacity
+            for(auto& block : blocks) {
+                polygonizator->clear();
+                polygonizator->PolygonizeSingleBlock(block.get(), 1);
+            }
+
+            auto allocationsBefore = AllocationCounter::getAllocations();
+            auto start = std::chrono::high_resolution_clock::now();
+            for(auto& block : blocks) {
+                polygonizator->clear();
+                polygonizator->PolygonizeSingleBlock(block.get(), 1);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            allocationsInRun = AllocationCounter::getAllocations() - allocationsBefore;
+            seconds = std::chrono::duration<double>(end - start).count();
+        }
+        auto leaked = AllocationCounter::getLiveAllocations() - liveBefore;
+
+        //Mesh memory of both vertex formats
+        size_t fullBytes = 0;
+        size_t packedBytes = 0;
+        {
+            auto polygonizator = std::make_unique<TransvoxelPolygonizator>();
+            for(auto& block : blocks) {
+                polygonizator->setVertexFormat(TransvoxelPolygonizator::FULL);
+                polygonizator->clear();
+                polygonizator->PolygonizeSingleBlock(block.get(), 1);
+                fullBytes += polygonizator->getVertices().size() * sizeof(TransvoxelPolygonizatorVertex) + polygonizator->getIndices().size() * sizeof(int);
+
+                polygonizator->setVertexFormat(TransvoxelPolygonizator::PACKED);
+                polygonizator->clear();
+                polygonizator->PolygonizeSingleBlock(block.get(), 1);
+                packedBytes += polygonizator->getPackedVertices().size() * sizeof(TransvoxelPackedVertex) + polygonizator->getPackedIndices().size() * sizeof(uint16_t);
+            }
+        }
+
+        auto cells = (double)blocks.size() * blockSize * blockSize * blockSize;
+        std::cout << "blocks: " << blocks.size() << " cells/s: " << std::fixed << std::setprecision(0) << cells / seconds << '\n';
+        std::cout << "mesh bytes per block, full: " << (double)fullBytes / blocks.size() << " packed: " << (double)packedBytes / blocks.size() << '\n';
+        if(AllocationCounter::isEnabled()) {
+            std::cout << "allocations per block: " << std::setprecision(2) << (double)allocationsInRun / blocks.size() << '\n';
+            std::cout << "allocations leaked: " << leaked << '\n';
+        } else {
+            std::cout << "allocation counting is disabled, configure with -DFLUORITE_COUNT_ALLOCATIONS=ON" << '\n';
+        }
+        return 0;
+    }
+
+    int TerrainBenchmarks::blockSize() {
+        auto defaultSize = TerrainDataBlock::getBlockSize();
+        //Same world volume is meshed with every size, 256 x 64 x 256 voxels
+        for(int size : {16, 32}) {
+            TerrainDataBlock::setBlockSize(size);
+            auto storage = TerrainDataBlockStorage(hills);
+            std::vector<std::shared_ptr<TerrainDataBlock>> blocks;
+            for(int x = 0; x < 256; x += size) {
+                for(int z = 0; z < 256; z += size) {
+                    for(int y = -32; y < 32; y += size) {
+                        blocks.push_back(storage.requestBlock(Vec3Int(x, y, z)));
+                    }
+                }
+            }
+
+            auto polygonizator = std::make_unique<TransvoxelPolygonizator>();
+            double bestSeconds = std::numeric_limits<double>::max();
+            size_t triangles = 0;
+            for(int run = 0; run < 3; run++) {
+                triangles = 0;
+                auto start = std::chrono::high_resolution_clock::now();
+                for(auto& block : blocks) {
+                    polygonizator->clear();
+                    polygonizator->PolygonizeSingleBlock(block.get(), 1);
+                    triangles += polygonizator->getIndices().size() / 3;
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(end - start).count());
+            }
+
+            auto cells = 256.0 * 64.0 * 256.0;
+            std::cout << "block size: " << size << " blocks: " << blocks.size() << " cells/s: " << std::fixed << std::setprecision(0) << cells / bestSeconds
+                << " triangles: " << triangles << '\n';
+        }
+        TerrainDataBlock::setBlockSize(defaultSize);
+        return 0;
+    }
+
+    int TerrainBenchmarks::simplifier() {
+        auto storage = TerrainDataBlockStorage(hills);
+        auto polygonizator = std::make_unique<TransvoxelPolygonizator>();
+        auto simplifier = TerrainMeshSimplifier();
+
+        for(int lod = 1; lod <= 3; lod++) {
+            //4 x 2 x 4 blocks of this LoD
+            std::vector<std::shared_ptr<TerrainDataBlock>> blocks;
+            auto blockExtent = TerrainDataBlock::getLevelBlockSize(lod);
+            for(int x = 0; x < 4; x++) {
+                for(int z = 0; z < 4; z++) {
+                    for(int y = -1; y < 1; y++) {
+                        blocks.push_back(storage.requestBlock(Vec3Int(x, y, z) * blockExtent, lod));
+                    }
+                }
+            }
+
+            //Errors are relative to voxel size of the LoD
+            auto scale = (float)(1 << (lod - 1));
+            for(float error : {0.125f, 0.25f, 0.5f, 1.0f}) {
+                int64_t before = 0;
+                int64_t after = 0;
+                float maxError = 0;
+                double seconds = 0;
+                for(auto& block : blocks) {
+                    polygonizator->clear();
+                    polygonizator->PolygonizeSingleBlock(block.get(), lod);
+                    auto vertices = polygonizator->getVertices();
+                    auto indices = polygonizator->getIndices();
+
+                    auto start = std::chrono::high_resolution_clock::now();
+                    auto report = simplifier.simplify(vertices, indices, lod, {0, error * scale});
+                    auto end = std::chrono::high_resolution_clock::now();
+                    seconds += std::chrono::duration<double>(end - start).count();
+                    before += report.trianglesBefore;
+                    after += report.trianglesAfter;
+                    maxError = std::max(maxError, report.maxError);
+                }
+                std::cout << "lod: " << lod << " error budget: " << std::fixed << std::setprecision(3) << error * scale
+                    << " triangles: " << before << " -> " << after << " removed: " << std::setprecision(1) << 100.0 * (before - after) / std::max<int64_t>(1, before) << "%"
+                    << " max error: " << std::setprecision(3) << maxError << " ms per block: " << seconds * 1000 / blocks.size() << '\n';
+            }
+        }
+        return 0;
+    }
+
+    bool TerrainBenchmarks::run(std::string name, int& exitCode) {
+        if(name == "--benchmark-meshing") {
+            exitCode = meshing();
+            return true;
+        }
+        if(name == "--benchmark-meshcache") {
+            exitCode = meshCache();
+            return true;
+        }
+        if(name == "--benchmark-blocksize") {
+            exitCode = blockSize();
+            return true;
+        }
+        if(name == "--benchmark-simplifier") {
+            exitCode = simplifier();
+            return true;
+        }
+        if(name == "--benchmark-polygonizer") {
+            exitCode = polygonizer();
+            return true;
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * Headless performance runs for terrain code. Results are printed to stdout
+     */
+    class TerrainBenchmarks {
+        private:
+            static std::vector<std::shared_ptr<TerrainDataBlock>> createBlocks(TerrainDataBlockStorage& storage, int sizeInBlocks);
+
+        public:
+            /**
+             * Hilly terrain all benchmarks run on, so their results are comparable
+             */
+            static TerrainDataBlockNode hills(Vec3Int pos);
+
+            /**
+             * Meshes a patch of hilly terrain with increasing number of threads and prints throughput
+             */
+            static int meshing();
+
+            /**
+             * Meshes a patch of terrain twice through TerrainMeshCache and prints throughput and hit rate of both passes
+             */
+            static int meshCache();
+
+            /**
+             * Runs a single polygonizer over a patch of terrain. Prints cells per second, heap allocations
+             * per block once polygonizer has warmed up, and allocations left alive after it was destroyed
+             */
+            static int polygonizer();
+
+            /**
+             * Polygonizes the same volume split into 16^3 and into 32^3 blocks and prints cells per second of both
+             */
+            static int blockSize();
+
+            /**
+             * Simplifies meshes of distant LoDs with growing error budgets and prints triangles removed against error added
+             */
+            static int simplifier();
+
+            /**
+             * Runs benchmark named by command line argument
+             * @return false if there is no such benchmark
+             */
+            static bool run(std::string name, int& exitCode);
+    };
+
+}
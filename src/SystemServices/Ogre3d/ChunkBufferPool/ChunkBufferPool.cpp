@@ -0,0 +1,89 @@
+#include <SystemServices/Ogre3d/ChunkBufferPool/ChunkBufferPool.hpp>
+
+namespace fluorite {
+
+    size_t ChunkBufferPool::getCapacity(size_t count) {
+        size_t capacity = minCapacity;
+        while(capacity < count) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    Ogre::HardwareVertexBufferSharedPtr ChunkBufferPool::acquireVertexBuffer(size_t vertexSize, size_t count) {
+        auto capacity = getCapacity(count);
+        auto& free = freeVertexBuffers[{vertexSize, capacity}];
+        if(!free.empty()) {
+            auto buffer = std::move(free.back());
+            free.pop_back();
+            stats.reused++;
+            stats.freeBuffers--;
+            stats.freeBytes -= buffer->getSizeInBytes();
+            return buffer;
+        }
+
+        auto buffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(vertexSize, capacity, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        stats.created++;
+        stats.allocatedBytes += buffer->getSizeInBytes();
+        return buffer;
+    }
+
+    Ogre::HardwareIndexBufferSharedPtr ChunkBufferPool::acquireIndexBuffer(Ogre::HardwareIndexBuffer::IndexType type, size_t count) {
+        auto capacity = getCapacity(count);
+        auto& free = freeIndexBuffers[{(int)type, capacity}];
+        if(!free.empty()) {
+            auto buffer = std::move(free.back());
+            free.pop_back();
+            stats.reused++;
+            stats.freeBuffers--;
+            stats.freeBytes -= buffer->getSizeInBytes();
+            return buffer;
+        }
+
+        auto buffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(type, capacity, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        stats.created++;
+        stats.allocatedBytes += buffer->getSizeInBytes();
+        return buffer;
+    }
+
+    void ChunkBufferPool::release(Ogre::HardwareVertexBufferSharedPtr buffer) {
+        if(!buffer) {
+            return;
+        }
+        auto bytes = buffer->getSizeInBytes();
+        if(stats.freeBytes + bytes > maxFreeBytes) {
+            //Last reference goes out of scope here and takes the GL buffer with it
+            stats.destroyed++;
+            stats.allocatedBytes -= bytes;
+            return;
+        }
+        freeVertexBuffers[{buffer->getVertexSize(), buffer->getNumVertices()}].push_back(std::move(buffer));
+        stats.freeBuffers++;
+        stats.freeBytes += bytes;
+    }
+
+    void ChunkBufferPool::release(Ogre::HardwareIndexBufferSharedPtr buffer) {
+        if(!buffer) {
+            return;
+        }
+        auto bytes = buffer->getSizeInBytes();
+        if(stats.freeBytes + bytes > maxFreeBytes) {
+            stats.destroyed++;
+            stats.allocatedBytes -= bytes;
+            return;
+        }
+        freeIndexBuffers[{(int)buffer->getType(), buffer->getNumIndexes()}].push_back(std::move(buffer));
+        stats.freeBuffers++;
+        stats.freeBytes += bytes;
+    }
+
+    void ChunkBufferPool::clear() {
+        freeVertexBuffers.clear();
+        freeIndexBuffers.clear();
+        stats.allocatedBytes -= stats.freeBytes;
+        stats.destroyed += stats.freeBuffers;
+        stats.freeBuffers = 0;
+        stats.freeBytes = 0;
+    }
+
+}
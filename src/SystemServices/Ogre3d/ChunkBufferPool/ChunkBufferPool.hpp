@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Ogre.h>
+#include <map>
+#include <vector>
+
+namespace fluorite {
+
+    /**
+     * Recycles hardware vertex and index buffers of terrain chunk meshes. Buffers are handed out in size classes(powers
+     * of two elements), so a buffer returned by an evicted chunk fits most of the chunks streamed in later, and
+     * streaming doesn't create and destroy GL buffers every frame. Meant for the render thread only
+     */
+    class ChunkBufferPool {
+        public:
+            struct Stats {
+                //Buffers created through HardwareBufferManager
+                int64_t created = 0;
+                //Requests served from the free lists
+                int64_t reused = 0;
+                //Released buffers dropped because free lists were over budget
+                int64_t destroyed = 0;
+                int freeBuffers = 0;
+                //Bytes of all buffers made by the pool and still alive, in use or free
+                size_t allocatedBytes = 0;
+                size_t freeBytes = 0;
+            };
+
+            //Smallest size class, in vertices or indices
+            static const size_t minCapacity = 1024;
+
+        private:
+            //(vertex size, capacity)
+            std::map<std::pair<size_t, size_t>, std::vector<Ogre::HardwareVertexBufferSharedPtr>> freeVertexBuffers;
+            //(index type, capacity)
+            std::map<std::pair<int, size_t>, std::vector<Ogre::HardwareIndexBufferSharedPtr>> freeIndexBuffers;
+            size_t maxFreeBytes;
+            Stats stats;
+
+        public:
+            /**
+             * @param maxFreeBytes released buffers over this amount are destroyed instead of kept for reuse
+             */
+            ChunkBufferPool(size_t maxFreeBytes = 32 * 1024 * 1024) : maxFreeBytes(maxFreeBytes) {}
+
+            ChunkBufferPool(const ChunkBufferPool&) = delete;
+            ChunkBufferPool& operator=(const ChunkBufferPool&) = delete;
+
+            /**
+             * Size class serving given number of elements
+             */
+            static size_t getCapacity(size_t count);
+
+            /**
+             * @return buffer with room for at least count vertices
+             */
+            Ogre::HardwareVertexBufferSharedPtr acquireVertexBuffer(size_t vertexSize, size_t count);
+            Ogre::HardwareIndexBufferSharedPtr acquireIndexBuffer(Ogre::HardwareIndexBuffer::IndexType type, size_t count);
+
+            /**
+             * Returns buffer made by acquire*Buffer. Caller must not use it afterwards, contents are overwritten by the next user
+             */
+            void release(Ogre::HardwareVertexBufferSharedPtr buffer);
+            void release(Ogre::HardwareIndexBufferSharedPtr buffer);
+
+            /**
+             * Destroys all free buffers. Must be called before the render system shuts down
+             */
+            void clear();
+
+            Stats getStats() const {
+                return stats;
+            }
+    };
+
+}
@@ -0,0 +1,195 @@
+#include <SystemServices/Ogre3d/GraphicsLifecycle/GraphicsLifecycle.hpp>
+
+namespace fluorite {
+
+    GraphicsLifecycle::Acquired GraphicsLifecycle::acquire(Kind kind, Ogre::Vector3 position) {
+        auto result = Acquired({nullptr, nullptr});
+        auto& objects = pooledObjects[kind];
+        if(!objects.empty()) {
+            result = {objects.back().first, objects.back().second};
+            objects.pop_back();
+            stats.recycled++;
+        } else if(!pooledNodes.empty()) {
+            result.node = pooledNodes.back();
+            pooledNodes.pop_back();
+            stats.recycled++;
+        } else {
+            result.node = sceneManager->createSceneNode();
+            stats.nodes++;
+        }
+
+        auto cell = hierarchy->acquire(position);
+        cell->addChild(result.node);
+        result.node->setPosition(position);
+        result.node->setOrientation(Ogre::Quaternion::IDENTITY);
+        result.node->setScale(Ogre::Vector3::UNIT_SCALE);
+
+        records[result.node] = Record({kind, result.object, {}, cell});
+        stats.objects++;
+        return result;
+    }
+
+    void GraphicsLifecycle::move(Ogre::SceneNode* node, Ogre::Vector3 position) {
+        auto& record = records.at(node);
+        auto cell = hierarchy->acquire(position);
+        if(cell != record.cell) {
+            record.cell->removeChild(node);
+            cell->addChild(node);
+            std::swap(cell, record.cell);
+        }
+        //Either the old cell or the extra count taken above
+        hierarchy->release(cell);
+        node->setPosition(position);
+    }
+
+    void GraphicsLifecycle::attach(Ogre::SceneNode* node, Ogre::MovableObject* object, Ogre::MeshPtr ownedMesh) {
+        auto& record = records.at(node);
+        node->attachObject(object);
+        record.object = object;
+        stats.movables++;
+        if(ownedMesh) {
+            record.ownedMesh = std::move(ownedMesh);
+            stats.meshes++;
+        }
+    }
+
+    void GraphicsLifecycle::release(Ogre::SceneNode* node) {
+        auto record = records.find(node);
+        if(record == records.end() || record->second.released) {
+            return;
+        }
+        record->second.released = true;
+        pending.push_back(node);
+        stats.objects--;
+    }
+
+    void GraphicsLifecycle::processPending(int maxNodes) {
+        auto count = std::min<size_t>(std::max(maxNodes, 0), pending.size());
+        for(size_t i = 0; i < count; i++) {
+            auto record = records.find(pending[i]);
+            destroyNode(record->first, record->second);
+            //Node is detached by now, so the cell can go with its last object
+            hierarchy->release(record->second.cell);
+            records.erase(record);
+        }
+        pending.erase(pending.begin(), pending.begin() + count);
+    }
+
+    void GraphicsLifecycle::destroyNode(Ogre::SceneNode* node, Record& record) {
+        switch(record.kind) {
+            case COLOUR_CUBE:
+            case INSTANCED_CUBE: {
+                auto& objects = pooledObjects[record.kind];
+                if(record.object && objects.size() < maxPooledPerKind) {
+                    //Off the scene graph the object is neither culled nor rendered
+                    if(auto parent = node->getParent()) {
+                        parent->removeChild(node);
+                    }
+                    objects.push_back({node, record.object});
+                    return;
+                }
+                if(record.object) {
+                    destroyMovable(record.kind, record.object);
+                }
+                break;
+            }
+            case TERRAIN_MESH: {
+                if(record.ownedMesh) {
+                    auto bind = record.ownedMesh->sharedVertexData->vertexBufferBinding;
+                    if(bind->isBufferBound(0)) {
+                        pool->release(bind->getBuffer(0));
+                    }
+                    bind->unsetAllBindings();
+                    pool->release(std::move(record.ownedMesh->getSubMesh(0)->indexData->indexBuffer));
+                }
+                if(record.object) {
+                    destroyMovable(record.kind, record.object);
+                }
+                if(record.ownedMesh) {
+                    Ogre::MeshManager::getSingleton().remove(record.ownedMesh);
+                    record.ownedMesh.reset();
+                    stats.meshes--;
+                }
+                break;
+            }
+            case GENERIC: {
+                if(record.object) {
+                    stats.movables--;
+                }
+                node->destroyAllChildrenAndObjects();
+                break;
+            }
+        }
+        recycleEmpty(node);
+    }
+
+    void GraphicsLifecycle::destroyMovable(Kind kind, Ogre::MovableObject* object) {
+        object->detachFromParent();
+        //Instanced entities have no MovableObjectFactory, so the scene manager can't destroy them by type
+        if(kind == INSTANCED_CUBE) {
+            sceneManager->destroyInstancedEntity(static_cast<Ogre::InstancedEntity*>(object));
+        } else {
+            sceneManager->destroyMovableObject(object);
+        }
+        stats.movables--;
+    }
+
+    void GraphicsLifecycle::recycleEmpty(Ogre::SceneNode* node) {
+        node->detachAllObjects();
+        if(auto parent = node->getParent()) {
+            parent->removeChild(node);
+        }
+        if(pooledNodes.size() < maxPooledPerKind) {
+            pooledNodes.push_back(node);
+            return;
+        }
+        sceneManager->destroySceneNode(node);
+        stats.nodes--;
+        stats.destroyedNodes++;
+    }
+
+    void GraphicsLifecycle::destroyAll() {
+        if(!sceneManager) {
+            return;
+        }
+        for(auto& [node, record] : records) {
+            if(!record.released) {
+                record.released = true;
+                pending.push_back(node);
+                stats.objects--;
+            }
+        }
+
+        auto maxPooled = maxPooledPerKind;
+        maxPooledPerKind = 0;
+        processPending((int)pending.size());
+        maxPooledPerKind = maxPooled;
+
+        for(auto& [kind, objects] : pooledObjects) {
+            for(auto& [node, object] : objects) {
+                destroyMovable(kind, object);
+                sceneManager->destroySceneNode(node);
+                stats.nodes--;
+                stats.destroyedNodes++;
+            }
+            objects.clear();
+        }
+        for(auto node : pooledNodes) {
+            sceneManager->destroySceneNode(node);
+            stats.nodes--;
+            stats.destroyedNodes++;
+        }
+        pooledNodes.clear();
+    }
+
+    GraphicsLifecycle::Stats GraphicsLifecycle::getStats() const {
+        auto result = stats;
+        result.pendingDestructions = (int)pending.size();
+        result.pooledNodes = (int)pooledNodes.size();
+        for(auto& [kind, objects] : pooledObjects) {
+            result.pooledNodes += (int)objects.size();
+        }
+        return result;
+    }
+
+}
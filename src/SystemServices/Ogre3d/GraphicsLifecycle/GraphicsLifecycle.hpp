@@ -0,0 +1,126 @@
+#pragma once
+
+#include <Ogre.h>
+#include <OgreInstancedEntity.h>
+#include <SystemServices/Ogre3d/ChunkBufferPool/ChunkBufferPool.hpp>
+#include <SystemServices/Ogre3d/SceneNodeHierarchy/SceneNodeHierarchy.hpp>
+#include <unordered_map>
+
+namespace fluorite {
+
+    /**
+     * Owns scene nodes, entities and meshes behind every GraphicsObject. Releasing an object only queues it, actual
+     * teardown runs at the end of the frame in bounded portions, so evicting many chunks at once doesn't stall the frame
+     * that evicted them. Nodes of objects built from shared meshes are detached from the scene and recycled together
+     * with their entity, other nodes are recycled empty. Live nodes hang in the cell of SceneNodeHierarchy containing
+     * their position. Counters of live Ogre objects make leaks visible.
+     * Meant for the render thread only
+     */
+    class GraphicsLifecycle {
+        public:
+            enum Kind {
+                //Node with arbitrary children and objects, destroyed with all of them
+                GENERIC,
+                //Entity of the shared ColourCube mesh, recycled with its node
+                COLOUR_CUBE,
+                //InstancedEntity of the ColourCube instance manager, recycled with its node
+                INSTANCED_CUBE,
+                //Entity of a mesh owned by the object, buffers go back to ChunkBufferPool
+                TERRAIN_MESH,
+            };
+
+            struct Stats {
+                //GraphicsObjects handed out and not released yet
+                int objects = 0;
+                //Everything owned, including recycled objects and objects waiting for destruction
+                int nodes = 0;
+                int movables = 0;
+                int meshes = 0;
+                int pooledNodes = 0;
+                int pendingDestructions = 0;
+                int64_t recycled = 0;
+                int64_t destroyedNodes = 0;
+            };
+
+            struct Acquired {
+                Ogre::SceneNode* node;
+                //Object of a recycled node, null when the caller has to create one and attach() it
+                Ogre::MovableObject* object;
+            };
+
+        private:
+            struct Record {
+                Kind kind;
+                Ogre::MovableObject* object = nullptr;
+                Ogre::MeshPtr ownedMesh;
+                //Parent from SceneNodeHierarchy
+                Ogre::SceneNode* cell = nullptr;
+                bool released = false;
+            };
+
+            Ogre::SceneManager* sceneManager = nullptr;
+            ChunkBufferPool* pool;
+            SceneNodeHierarchy* hierarchy;
+            std::unordered_map<Ogre::SceneNode*, Record> records;
+            std::vector<Ogre::SceneNode*> pending;
+            //Detached nodes with their object still attached, per kind
+            std::map<Kind, std::vector<std::pair<Ogre::SceneNode*, Ogre::MovableObject*>>> pooledObjects;
+            //Detached nodes without objects
+            std::vector<Ogre::SceneNode*> pooledNodes;
+            size_t maxPooledPerKind;
+            Stats stats;
+
+            void destroyMovable(Kind kind, Ogre::MovableObject* object);
+            void destroyNode(Ogre::SceneNode* node, Record& record);
+            void recycleEmpty(Ogre::SceneNode* node);
+
+        public:
+            /**
+             * @param maxPooledPerKind recycled nodes kept per kind, nodes over the limit are destroyed
+             */
+            GraphicsLifecycle(ChunkBufferPool* pool, SceneNodeHierarchy* hierarchy, size_t maxPooledPerKind = 4096)
+                : pool(pool), hierarchy(hierarchy), maxPooledPerKind(maxPooledPerKind) {}
+
+            GraphicsLifecycle(const GraphicsLifecycle&) = delete;
+            GraphicsLifecycle& operator=(const GraphicsLifecycle&) = delete;
+
+            void setSceneManager(Ogre::SceneManager* manager) {
+                sceneManager = manager;
+            }
+
+            /**
+             * Node attached to the hierarchy cell containing position, recycled when possible. Position is set,
+             * orientation and scale are reset
+             */
+            Acquired acquire(Kind kind, Ogre::Vector3 position);
+
+            /**
+             * Sets position of an acquired node, moving it to another hierarchy cell when it leaves its own
+             */
+            void move(Ogre::SceneNode* node, Ogre::Vector3 position);
+
+            /**
+             * Attaches newly created object to an acquired node
+             * @param ownedMesh mesh created for this object only, removed together with it
+             */
+            void attach(Ogre::SceneNode* node, Ogre::MovableObject* object, Ogre::MeshPtr ownedMesh = {});
+
+            /**
+             * Queues node for destruction at the end of frame. Releasing a node twice or a node not made through acquire does nothing
+             */
+            void release(Ogre::SceneNode* node);
+
+            /**
+             * Tears down at most maxNodes released nodes, oldest first
+             */
+            void processPending(int maxNodes);
+
+            /**
+             * Destroys everything, including live objects. Must be called before the scene manager is destroyed
+             */
+            void destroyAll();
+
+            Stats getStats() const;
+    };
+
+}
@@ -0,0 +1,233 @@
+#include <SystemServices/Ogre3d/OcclusionCuller/OcclusionCuller.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <misc/Simd.hpp>
+
+namespace fluorite {
+
+    static constexpr float farDepth = std::numeric_limits<float>::max();
+
+    OcclusionCuller::OcclusionCuller() : OcclusionCuller(Settings()) {}
+
+    OcclusionCuller::OcclusionCuller(Settings newSettings) : settings(newSettings) {
+        settings.width = (settings.width + 3) & ~3;
+        depth.resize(settings.width * settings.height, farDepth);
+    }
+
+    void OcclusionCuller::beginFrame(const Ogre::Matrix4& matrix, Ogre::Vector3 newEye, float newNearDistance) {
+        for(int row = 0; row < 4; row++) {
+            for(int column = 0; column < 4; column++) {
+                viewProj[row][column] = (float)matrix[row][column];
+            }
+        }
+        eye = newEye;
+        nearDistance = newNearDistance;
+        occluders.clear();
+        hasOccluders = false;
+        stats = Stats();
+    }
+
+    OcclusionCuller::ScreenVertex OcclusionCuller::project(const Ogre::Vector3& pos) const {
+        auto clip = [&](int row) {
+            return viewProj[row][0] * pos.x + viewProj[row][1] * pos.y + viewProj[row][2] * pos.z + viewProj[row][3];
+        };
+        auto w = clip(3);
+        if(w < nearDistance) {
+            return {0, 0, w};
+        }
+        return {(clip(0) / w * 0.5f + 0.5f) * settings.width, (clip(1) / w * 0.5f + 0.5f) * settings.height, w};
+    }
+
+    bool OcclusionCuller::isOccluderCandidate(const Ogre::AxisAlignedBox& box) const {
+        auto closest = eye;
+        closest.makeCeil(box.getMinimum());
+        closest.makeFloor(box.getMaximum());
+        return closest.squaredDistance(eye) <= settings.occluderDistance * settings.occluderDistance;
+    }
+
+    void OcclusionCuller::addOccluder(const Ogre::AxisAlignedBox& box) {
+        auto center = (box.getMinimum() + box.getMaximum()) * 0.5f;
+        occluders.push_back({center.squaredDistance(eye), box});
+    }
+
+    void OcclusionCuller::rasterize() {
+        std::fill(depth.begin(), depth.end(), farDepth);
+        auto count = std::min<size_t>(occluders.size(), settings.maxOccluders);
+        std::partial_sort(occluders.begin(), occluders.begin() + count, occluders.end(), [](auto& a, auto& b) { return a.first < b.first; });
+        for(size_t i = 0; i < count; i++) {
+            rasterizeBox(occluders[i].second);
+        }
+        stats.occluders = (int)count;
+        hasOccluders = stats.rasterizedTriangles > 0;
+    }
+
+    void OcclusionCuller::rasterizeBox(const Ogre::AxisAlignedBox& box) {
+        auto lo = box.getMinimum();
+        auto hi = box.getMaximum();
+        //Camera inside the box sees nothing of it worth rasterizing
+        if(eye.x > lo.x && eye.x < hi.x && eye.y > lo.y && eye.y < hi.y && eye.z > lo.z && eye.z < hi.z) {
+            return;
+        }
+
+        //Corner i has maximum on axis a when bit a of i is set
+        ScreenVertex corners[8];
+        float farthest = 0;
+        for(int i = 0; i < 8; i++) {
+            corners[i] = project(Ogre::Vector3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z));
+            //Clipping isn't worth it, occluders reaching behind the near plane are just skipped
+            if(corners[i].w < nearDistance) {
+                return;
+            }
+            farthest = std::max(farthest, corners[i].w);
+        }
+
+        //Only faces turned to the camera, at most three of them
+        static const int faces[6][4] = {
+            {0, 4, 6, 2}, {1, 3, 7, 5},
+            {0, 1, 5, 4}, {2, 6, 7, 3},
+            {0, 2, 3, 1}, {4, 5, 7, 6},
+        };
+        bool facing[6] = {eye.x < lo.x, eye.x > hi.x, eye.y < lo.y, eye.y > hi.y, eye.z < lo.z, eye.z > hi.z};
+        for(int face = 0; face < 6; face++) {
+            if(!facing[face]) {
+                continue;
+            }
+            auto& quad = faces[face];
+            //Farthest vertex of the whole box keeps depth conservative without interpolation
+            rasterizeTriangle(corners[quad[0]], corners[quad[1]], corners[quad[2]], farthest);
+            rasterizeTriangle(corners[quad[0]], corners[quad[2]], corners[quad[3]], farthest);
+        }
+    }
+
+    void OcclusionCuller::rasterizeTriangle(ScreenVertex a, ScreenVertex b, ScreenVertex c, float triangleDepth) {
+        auto edge = [](const ScreenVertex& from, const ScreenVertex& to, float x, float y) {
+            return (to.x - from.x) * (y - from.y) - (to.y - from.y) * (x - from.x);
+        };
+        auto area = edge(a, b, c.x, c.y);
+        if(area == 0) {
+            return;
+        }
+        if(area < 0) {
+            std::swap(b, c);
+        }
+
+        int x0 = std::max(0, (int)std::floor(std::min({a.x, b.x, c.x})));
+        int x1 = std::min(settings.width - 1, (int)std::floor(std::max({a.x, b.x, c.x})));
+        int y0 = std::max(0, (int)std::floor(std::min({a.y, b.y, c.y})));
+        int y1 = std::min(settings.height - 1, (int)std::floor(std::max({a.y, b.y, c.y})));
+        if(x0 > x1 || y0 > y1) {
+            return;
+        }
+        stats.rasterizedTriangles++;
+
+        //Edge functions change by a constant step per pixel. Groups of 4 start at a multiple of 4, so they never cross the end of a row
+        x0 &= ~3;
+        const ScreenVertex* from[3] = {&a, &b, &c};
+        const ScreenVertex* to[3] = {&b, &c, &a};
+        float stepX[3];
+        for(int e = 0; e < 3; e++) {
+            stepX[e] = -(to[e]->y - from[e]->y);
+        }
+
+        for(int y = y0; y <= y1; y++) {
+            auto row = depth.data() + y * settings.width;
+            float start[3];
+            for(int e = 0; e < 3; e++) {
+                start[e] = edge(*from[e], *to[e], x0 + 0.5f, y + 0.5f);
+            }
+#ifdef FLUORITE_SSE2
+            __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+            __m128 e0 = _mm_add_ps(_mm_set1_ps(start[0]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[0])));
+            __m128 e1 = _mm_add_ps(_mm_set1_ps(start[1]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[1])));
+            __m128 e2 = _mm_add_ps(_mm_set1_ps(start[2]), _mm_mul_ps(lanes, _mm_set1_ps(stepX[2])));
+            __m128 step0 = _mm_set1_ps(stepX[0] * 4);
+            __m128 step1 = _mm_set1_ps(stepX[1] * 4);
+            __m128 step2 = _mm_set1_ps(stepX[2] * 4);
+            __m128 zero = _mm_setzero_ps();
+            __m128 triangle = _mm_set1_ps(triangleDepth);
+            for(int x = x0; x <= x1; x += 4) {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(current, triangle);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                e0 = _mm_add_ps(e0, step0);
+                e1 = _mm_add_ps(e1, step1);
+                e2 = _mm_add_ps(e2, step2);
+            }
+#else
+            for(int x = x0; x <= x1; x++) {
+                auto offset = (float)(x - x0);
+                if(start[0] + offset * stepX[0] >= 0 && start[1] + offset * stepX[1] >= 0 && start[2] + offset * stepX[2] >= 0) {
+                    row[x] = std::min(row[x], triangleDepth);
+                }
+            }
+#endif
+        }
+    }
+
+    bool OcclusionCuller::isVisible(const Ogre::AxisAlignedBox& box) {
+        stats.tested++;
+        if(!hasOccluders) {
+            return true;
+        }
+
+        auto lo = box.getMinimum();
+        auto hi = box.getMaximum();
+        float minX = farDepth, minY = farDepth, maxX = -farDepth, maxY = -farDepth, nearest = farDepth;
+        for(int i = 0; i < 8; i++) {
+            auto corner = project(Ogre::Vector3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z));
+            if(corner.w < nearDistance) {
+                return true;
+            }
+            minX = std::min(minX, corner.x);
+            maxX = std::max(maxX, corner.x);
+            minY = std::min(minY, corner.y);
+            maxY = std::max(maxY, corner.y);
+            nearest = std::min(nearest, corner.w);
+        }
+
+        //Parts off screen can't be checked, frustum culling takes care of boxes that are entirely off screen
+        if(minX < 0 || minY < 0 || maxX >= settings.width || maxY >= settings.height) {
+            return true;
+        }
+        int x0 = (int)minX;
+        int x1 = (int)maxX;
+        int y0 = (int)minY;
+        int y1 = (int)maxY;
+
+        for(int y = y0; y <= y1; y++) {
+            auto row = depth.data() + y * settings.width;
+#ifdef FLUORITE_SSE2
+            __m128 boxDepth = _mm_set1_ps(nearest);
+            for(int x = x0 & ~3; x <= x1; x += 4) {
+                //Lanes left of x0 or right of x1 belong to other pixels
+                int lanes = 0xF;
+                if(x < x0) {
+                    lanes &= 0xF << (x0 - x);
+                }
+                if(x + 3 > x1) {
+                    lanes &= 0xF >> (x + 3 - x1);
+                }
+                if(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) & lanes) {
+                    return true;
+                }
+            }
+#else
+            for(int x = x0; x <= x1; x++) {
+                if(row[x] >= nearest) {
+                    return true;
+                }
+            }
+#endif
+        }
+        stats.culled++;
+        return false;
+    }
+
+    OcclusionCuller::Stats OcclusionCuller::getStats() const {
+        return stats;
+    }
+
+}
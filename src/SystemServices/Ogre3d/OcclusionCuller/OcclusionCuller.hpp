@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Ogre.h>
+#include <vector>
+
+namespace fluorite {
+
+    /**
+     * Software occlusion culling on the CPU. Nearby occluder boxes(see TerrainOccluders) are rasterized into a small
+     * depth buffer every frame, then bounding boxes are tested against it before they are drawn. Both steps are
+     * conservative: occluder triangles are written at the depth of their farthest vertex, a tested box at the depth of
+     * its nearest corner, and boxes crossing the near plane or the screen edge are always visible. Rows are processed
+     * 4 pixels at a time with SSE2 where available
+     */
+    class OcclusionCuller {
+        public:
+            struct Settings {
+                //Width is rounded up to a multiple of 4
+                int width = 256;
+                int height = 128;
+                //Nearest occluders are rasterized first, the rest is ignored
+                int maxOccluders = 2048;
+                //Occluders farther from the camera are ignored
+                float occluderDistance = 256;
+            };
+
+            struct Stats {
+                int occluders = 0;
+                int rasterizedTriangles = 0;
+                int tested = 0;
+                int culled = 0;
+            };
+
+        private:
+            struct ScreenVertex {
+                float x;
+                float y;
+                //Clip space w, distance along the view direction
+                float w;
+            };
+
+            Settings settings;
+            std::vector<float> depth;
+            float viewProj[4][4];
+            Ogre::Vector3 eye;
+            float nearDistance = 0;
+            std::vector<std::pair<float, Ogre::AxisAlignedBox>> occluders;
+            bool hasOccluders = false;
+            Stats stats;
+
+            ScreenVertex project(const Ogre::Vector3& pos) const;
+            void rasterizeBox(const Ogre::AxisAlignedBox& box);
+            void rasterizeTriangle(ScreenVertex a, ScreenVertex b, ScreenVertex c, float triangleDepth);
+
+        public:
+            OcclusionCuller();
+            OcclusionCuller(Settings settings);
+
+            /**
+             * Clears depth buffer and occluders
+             * @param viewProj projection matrix multiplied by view matrix
+             * @param nearDistance near clip distance of the camera
+             */
+            void beginFrame(const Ogre::Matrix4& viewProj, Ogre::Vector3 eye, float nearDistance);
+
+            /**
+             * True when box is close enough to the camera for its occluders to be worth adding
+             */
+            bool isOccluderCandidate(const Ogre::AxisAlignedBox& box) const;
+
+            bool isEnabled() const {
+                return settings.maxOccluders > 0;
+            }
+
+            void addOccluder(const Ogre::AxisAlignedBox& box);
+
+            /**
+             * Rasterizes occluders added since beginFrame. Must be called before isVisible
+             */
+            void rasterize();
+
+            /**
+             * False only if the box is completely hidden behind rasterized occluders
+             */
+            bool isVisible(const Ogre::AxisAlignedBox& box);
+
+            Stats getStats() const;
+    };
+
+}
@@ -1,17 +1,27 @@
 #include <SystemServices/Ogre3d/Ogre3d.hpp>
 
-#include <Terrain/Terrain.hpp>
+#include <OgreInstanceManager.h>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <cstddef>
+#include <cstdio>
 
 namespace fluorite
 {
 
+    static_assert(sizeof(TransvoxelPolygonizatorVertex) == 6 * sizeof(float), "Full vertex format is uploaded as is, as two VET_FLOAT3");
+
     /**
      * Simple class for some test cubes
      */
     class DebugMeshesGenerator {
     private:
         static bool isInited;
+        //Scene manager of Ogre3d, looked up once by init
+        static Ogre::SceneManager* sceneManager;
+        //Null when render system can't instance, coloured cubes are then ordinary entities
+        static Ogre::InstanceManager* colourCubeInstances;
 
         static void createColourCube() {
                 /// Create the mesh via the MeshManager
@@ -261,169 +271,447 @@ namespace fluorite
             msh->load();
         }
 
-        static void createMeshFromVertices(std::string name, std::vector<Ogre::Vector3> vertices, std::vector<int> indices, Ogre::Vector3 size = {1,1,1}) {
-            /// Create the mesh via the MeshManager
-            Ogre::MeshPtr msh = Ogre::MeshManager::getSingleton().createManual(name, "General");
-
-            /// Create one submesh
-            Ogre::SubMesh* sub = msh->createSubMesh();
-
-
-            Ogre::RenderSystem* rs = Ogre::Root::getSingleton().getRenderSystem();
-
-            /// Create vertex data structure for 8 vertices shared between submeshes
-            msh->sharedVertexData = new Ogre::VertexData();
-            msh->sharedVertexData->vertexCount = vertices.size();
-
-            /// Create declaration (memory format) of vertex data
-            Ogre::VertexDeclaration* decl = msh->sharedVertexData->vertexDeclaration;
-            size_t offset = 0;
-            // 1st buffer
-            decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
-            offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-            //decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
-            //offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-            /// Allocate vertex buffer of the requested number of vertices (vertexCount) 
-            /// and bytes per vertex (offset)
-            Ogre::HardwareVertexBufferSharedPtr vbuf = 
-                Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
-                offset, msh->sharedVertexData->vertexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-            /// Upload the vertex data to the card
-            vbuf->writeData(0, vbuf->getSizeInBytes(), vertices.data(), true);
-
-            /// Set vertex buffer binding so buffer 0 is bound to our vertex buffer
-            Ogre::VertexBufferBinding* bind = msh->sharedVertexData->vertexBufferBinding; 
-            bind->setBinding(0, vbuf);
+        /**
+         * Fills mesh with geometry of a terrain block. Buffers already bound to the mesh are written in place when the
+         * geometry fits, otherwise they are swapped for pooled ones of a matching size class.
+         * Packed format is 12 bytes per vertex and 16 bit indices, with positions in fixed point cell units, so node
+         * showing the mesh must be scaled by TransvoxelPackedVertex::getPositionScale. Full format is uploaded as
+         * TransvoxelPolygonizatorVertex, interleaved float positions and normals. Either way the vertex declaration
+         * matches the polygonizer's own layout, so vertices are copied once, straight from the viewed buffers.
+         * Empty mesh gives its buffers back to the pool instead of holding any, entity showing it must be hidden
+         */
+        static void writeTerrainMesh(Ogre::Mesh* msh, const TerrainMeshView& mesh, ChunkBufferPool& pool) {
+            if(mesh.isEmpty()) {
+                auto vertexData = msh->sharedVertexData;
+                vertexData->vertexCount = 0;
+                if(vertexData->vertexBufferBinding->isBufferBound(0)) {
+                    pool.release(vertexData->vertexBufferBinding->getBuffer(0));
+                    vertexData->vertexBufferBinding->unsetBinding(0);
+                }
+                auto indexData = msh->getSubMesh(0)->indexData;
+                pool.release(std::move(indexData->indexBuffer));
+                indexData->indexCount = 0;
+                msh->_setBounds(Ogre::AxisAlignedBox::BOX_NULL);
+                msh->_setBoundingSphereRadius(0);
+                return;
+            }
 
-            /// Allocate index buffer of the requested number of vertices (ibufCount) 
-            Ogre::HardwareIndexBufferSharedPtr ibuf = Ogre::HardwareBufferManager::getSingleton().
-                createIndexBuffer(
-                Ogre::HardwareIndexBuffer::IT_32BIT, 
-                indices.size(), 
-                Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            bool packed = !mesh.packedIndices.empty();
+            size_t vertexCount = packed ? mesh.packedVertices.size() : mesh.vertices.size();
+            size_t indexCount = packed ? mesh.packedIndices.size() : mesh.indices.size();
+            size_t vertexSize = packed ? sizeof(TransvoxelPackedVertex) : sizeof(TransvoxelPolygonizatorVertex);
+            auto indexType = packed ? Ogre::HardwareIndexBuffer::IT_16BIT : Ogre::HardwareIndexBuffer::IT_32BIT;
+
+            auto vertexData = msh->sharedVertexData;
+            vertexData->vertexCount = vertexCount;
+
+            Ogre::VertexDeclaration* decl = vertexData->vertexDeclaration;
+            decl->removeAllElements();
+            if(packed) {
+                //Layout must match TransvoxelPackedVertex
+                decl->addElement(0, offsetof(TransvoxelPackedVertex, pos), Ogre::VET_SHORT4, Ogre::VES_POSITION);
+                decl->addElement(0, offsetof(TransvoxelPackedVertex, normal), Ogre::VET_BYTE4_NORM, Ogre::VES_NORMAL);
+            } else {
+                //Layout must match TransvoxelPolygonizatorVertex
+                decl->addElement(0, offsetof(TransvoxelPolygonizatorVertex, pos), Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+                decl->addElement(0, offsetof(TransvoxelPolygonizatorVertex, normal), Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+            }
 
-            /// Upload the index data to the card
-            ibuf->writeData(0, ibuf->getSizeInBytes(), indices.data(), true);
+            Ogre::VertexBufferBinding* bind = vertexData->vertexBufferBinding;
+            Ogre::HardwareVertexBufferSharedPtr vbuf;
+            if(bind->isBufferBound(0)) {
+                vbuf = bind->getBuffer(0);
+            }
+            if(!vbuf || vbuf->getVertexSize() != vertexSize || vbuf->getNumVertices() < vertexCount) {
+                pool.release(std::move(vbuf));
+                vbuf = pool.acquireVertexBuffer(vertexSize, vertexCount);
+                bind->setBinding(0, vbuf);
+            }
+            if(vertexCount > 0) {
+                auto vertices = packed ? (const void*)mesh.packedVertices.data() : (const void*)mesh.vertices.data();
+                vbuf->writeData(0, vertexCount * vertexSize, vertices, true);
+            }
 
-            /// Set parameters of the submesh
+            Ogre::SubMesh* sub = msh->getSubMesh(0);
+            auto& ibuf = sub->indexData->indexBuffer;
+            if(!ibuf || ibuf->getType() != indexType || ibuf->getNumIndexes() < indexCount) {
+                pool.release(std::move(ibuf));
+                ibuf = pool.acquireIndexBuffer(indexType, indexCount);
+            }
+            if(indexCount > 0) {
+                auto indices = packed ? (const void*)mesh.packedIndices.data() : (const void*)mesh.indices.data();
+                ibuf->writeData(0, indexCount * ibuf->getIndexSize(), indices, true);
+            }
             sub->useSharedVertices = true;
-            sub->indexData->indexBuffer = ibuf;
-            sub->indexData->indexCount = indices.size();
+            sub->indexData->indexCount = indexCount;
             sub->indexData->indexStart = 0;
 
-            /// Set bounding information (for culling)
+            //Packed block spans getBlockSize() cells, 256 units each
+            auto size = packed ? Ogre::Vector3(TerrainDataBlock::getBlockSize() * 256.0f) : Ogre::Vector3(TerrainDataBlock::getLevelBlockSize(mesh.lod));
             msh->_setBounds(Ogre::AxisAlignedBox(Ogre::Vector3(0), size));
             msh->_setBoundingSphereRadius(size.length());
+        }
 
-            /// Notify -Mesh object that it has been loaded
-            msh->load();
+        static void placeTerrainNode(Ogre::SceneNode* node, const TerrainMeshView& mesh) {
+            node->setPosition(OgreVecFromV3I(mesh.blockPos));
+            if(!mesh.packedIndices.empty()) {
+                node->setScale(Ogre::Vector3(TransvoxelPackedVertex::getPositionScale(mesh.lod)));
+            } else {
+                node->setScale(Ogre::Vector3::UNIT_SCALE);
+            }
         }
 
         static void createTestMaterial() {
             Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create("Test/ColourTest", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
             material->getTechnique(0)->getPass(0)->setPolygonMode(Ogre::PolygonMode::PM_WIREFRAME);
             material->getTechnique(0)->getPass(0)->setVertexColourTracking(Ogre::TVC_AMBIENT);
-            
+            //Packed terrain nodes are scaled far below 1, normals must be renormalised or lighting goes dark
+            material->getTechnique(0)->getPass(0)->setNormaliseNormals(true);
         }
 
-        Ogre::SceneNode* putMesh(Ogre::String name, Ogre::Vector3 pos, std::vector<Ogre::Vector3> vertices, std::vector<int> indices, Ogre::Vector3 size = {1,1,1}, Ogre::ColourValue color = Ogre::ColourValue::ZERO) {
+        /**
+         * Materials are shared by all entities of the same colour instead of being created per entity
+         */
+        static Ogre::MaterialPtr getColourMaterial(Ogre::ColourValue color, bool wireframe) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "Test/Colour/%08X%s", color.getAsRGBA(), wireframe ? "/Wire" : "");
+
+            auto& materials = Ogre::MaterialManager::getSingleton();
+            auto material = materials.getByName(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            if(!material) {
+                material = materials.create(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+                material->getTechnique(0)->getPass(0)->setAmbient(color);
+                if(wireframe) {
+                    material->getTechnique(0)->getPass(0)->setPolygonMode(Ogre::PolygonMode::PM_WIREFRAME);
+                }
+            }
+            return material;
+        }
+
+        /**
+         * Single material for all instanced cubes. World matrix comes in uv0-uv2 and colour in uv3(custom parameter 0),
+         * as laid out by InstanceManager::HWInstancingBasic for a mesh without texture coordinates
+         */
+        static void createInstancedColourMaterial() {
+            auto& programs = Ogre::GpuProgramManager::getSingleton();
+            auto vertexProgram = programs.createProgram("Test/InstancedColourVP", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, "glsl", Ogre::GPT_VERTEX_PROGRAM);
+            vertexProgram->setSource(
+                "#version 120\n"
+                "attribute vec4 vertex;\n"
+                "attribute vec4 uv0;\n"
+                "attribute vec4 uv1;\n"
+                "attribute vec4 uv2;\n"
+                "attribute vec4 uv3;\n"
+                "uniform mat4 viewProjMatrix;\n"
+                "varying vec4 colour;\n"
+                "void main() {\n"
+                "    mat4 worldMatrix;\n"
+                "    worldMatrix[0] = uv0;\n"
+                "    worldMatrix[1] = uv1;\n"
+                "    worldMatrix[2] = uv2;\n"
+                "    worldMatrix[3] = vec4(0, 0, 0, 1);\n"
+                "    gl_Position = viewProjMatrix * (vertex * worldMatrix);\n"
+                "    colour = uv3;\n"
+                "}\n");
+            vertexProgram->load();
+            vertexProgram->getDefaultParameters()->setNamedAutoConstant("viewProjMatrix", Ogre::GpuProgramParameters::ACT_VIEWPROJ_MATRIX);
+
+            //Same result as fixed function pass with ambient colour and no lights
+            auto fragmentProgram = programs.createProgram("Test/InstancedColourFP", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, "glsl", Ogre::GPT_FRAGMENT_PROGRAM);
+            fragmentProgram->setSource(
+                "#version 120\n"
+                "uniform vec4 ambient;\n"
+                "varying vec4 colour;\n"
+                "void main() {\n"
+                "    gl_FragColor = vec4(colour.rgb * ambient.rgb, colour.a);\n"
+                "}\n");
+            fragmentProgram->load();
+            fragmentProgram->getDefaultParameters()->setNamedAutoConstant("ambient", Ogre::GpuProgramParameters::ACT_AMBIENT_LIGHT_COLOUR);
+
+            Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create("Test/InstancedColour", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            auto pass = material->getTechnique(0)->getPass(0);
+            pass->setVertexProgram("Test/InstancedColourVP");
+            pass->setFragmentProgram("Test/InstancedColourFP");
+            pass->setPolygonMode(Ogre::PolygonMode::PM_WIREFRAME);
+        }
 
-            if(pos.x == 16 && pos.y == 0 && pos.z == 0) {
-                        std::cout << name;
+    public:
+        /**
+         * Creates shared meshes and materials, safe to call repeatedly. Must run before anything is put into the scene
+         */
+        static void init(Ogre::SceneManager* manager) {
+            if(isInited) {
+                return;
             }
+            sceneManager = manager;
+            createColourUnitCube();
+            createTestMaterial();
+
+            auto capabilities = Ogre::Root::getSingleton().getRenderSystem()->getCapabilities();
+            if(capabilities->hasCapability(Ogre::RSC_VERTEX_BUFFER_INSTANCE_DATA)) {
+                createInstancedColourMaterial();
+                colourCubeInstances = sceneManager->createInstanceManager("ColourCubes", "ColourCube",
+                    Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::InstanceManager::HWInstancingBasic, 1024);
+                //Colour of every cube, must be set before the first batch is built
+                colourCubeInstances->setNumCustomParams(1);
+            }
+            isInited = true;
+        }
 
-            createMeshFromVertices(name, vertices, indices, size);
+        static Ogre::SceneNode* putTerrainMesh(const TerrainMeshView& mesh, ChunkBufferPool& pool, GraphicsLifecycle& lifecycle) {
+            static int meshCounter = 0;
 
-            auto mainSceneManager = Ogre::Root::getSingletonPtr()->getSceneManagers().begin()->second;
+            auto name = "Terrain/" + std::to_string(meshCounter++);
+            auto thisSceneNode = lifecycle.acquire(GraphicsLifecycle::TERRAIN_MESH, OgreVecFromV3I(mesh.blockPos)).node;
+            placeTerrainNode(thisSceneNode, mesh);
 
-            auto thisEntity = mainSceneManager->createEntity(name, name);
+            Ogre::MeshPtr msh = Ogre::MeshManager::getSingleton().createManual(name, "General");
+            msh->createSubMesh();
+            msh->sharedVertexData = new Ogre::VertexData();
+            writeTerrainMesh(msh.get(), mesh, pool);
+            msh->load();
 
-            if(color == Ogre::ColourValue::ZERO) {
-                thisEntity->setMaterialName("Test/ColourTest");
-            } else {
-                Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create("Test/" + thisEntity->getName(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-                material->getTechnique(0)->getPass(0)->setAmbient(color);
-                thisEntity->setMaterial(material);
-            }
-            auto thisSceneNode = mainSceneManager->getRootSceneNode()->createChildSceneNode();
-            thisSceneNode->setPosition(pos);
-            thisSceneNode->attachObject(thisEntity);
+            auto thisEntity = sceneManager->createEntity(name, name);
+            thisEntity->setMaterialName("Test/ColourTest");
+            thisEntity->setVisible(!mesh.isEmpty());
+            lifecycle.attach(thisSceneNode, thisEntity, msh);
 
             return thisSceneNode;
         }
 
-    public:
-        static Ogre::SceneNode* putTestCube(Ogre::Vector3 pos, Ogre::Vector3 size = {1,1,1}, Ogre::ColourValue color = Ogre::ColourValue::ZERO) {
+        static void updateTerrainMesh(Ogre::SceneNode* node, const TerrainMeshView& mesh, ChunkBufferPool& pool) {
+            auto entity = static_cast<Ogre::Entity*>(node->getAttachedObject(0));
+            writeTerrainMesh(entity->getMesh().get(), mesh, pool);
+            entity->setVisible(!mesh.isEmpty());
+            placeTerrainNode(node, mesh);
+            node->needUpdate();
+        }
 
-            if(!isInited) {
-                createColourUnitCube();
-                createTestMaterial();
-                isInited = true;
+        /**
+         * Coloured cubes are drawn as instances of one batch when the render system supports it.
+         * Recycled cubes come with their entity, only colour and material are set again
+         */
+        static Ogre::SceneNode* putTestCube(GraphicsLifecycle& lifecycle, Ogre::Vector3 pos, Ogre::Vector3 size = {1,1,1}, Ogre::ColourValue color = Ogre::ColourValue::ZERO) {
+            bool instanced = color != Ogre::ColourValue::ZERO && colourCubeInstances;
+            auto acquired = lifecycle.acquire(instanced ? GraphicsLifecycle::INSTANCED_CUBE : GraphicsLifecycle::COLOUR_CUBE, pos);
+            auto thisSceneNode = acquired.node;
+            thisSceneNode->setScale(size);
+
+            if(instanced) {
+                auto instance = static_cast<Ogre::InstancedEntity*>(acquired.object);
+                if(!instance) {
+                    instance = sceneManager->createInstancedEntity("Test/InstancedColour", "ColourCubes");
+                    lifecycle.attach(thisSceneNode, instance);
+                }
+                instance->setCustomParam(0, Ogre::Vector4(color.r, color.g, color.b, color.a));
+                return thisSceneNode;
             }
 
-            auto mainSceneManager = Ogre::Root::getSingletonPtr()->getSceneManagers().begin()->second;
-
-
-            auto thisEntity = mainSceneManager->createEntity("ColourCube");
-
+            auto thisEntity = static_cast<Ogre::Entity*>(acquired.object);
+            if(!thisEntity) {
+                thisEntity = sceneManager->createEntity("ColourCube");
+                lifecycle.attach(thisSceneNode, thisEntity);
+            }
             if(color == Ogre::ColourValue::ZERO) {
                 thisEntity->setMaterialName("Test/ColourTest");
             } else {
-                Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create("Test/" + thisEntity->getName(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-                material->getTechnique(0)->getPass(0)->setAmbient(color);
-                material->getTechnique(0)->getPass(0)->setPolygonMode(Ogre::PolygonMode::PM_WIREFRAME);
-                thisEntity->setMaterial(material);
+                thisEntity->setMaterial(getColourMaterial(color, true));
             }
-            auto thisSceneNode = mainSceneManager->getRootSceneNode()->createChildSceneNode();
-            thisSceneNode->setPosition(pos);
-            thisSceneNode->attachObject(thisEntity);
-            thisSceneNode->scale(size);
 
             return thisSceneNode;
-        }    
+        }
     };
     bool DebugMeshesGenerator::isInited = false;
+    Ogre::SceneManager* DebugMeshesGenerator::sceneManager = nullptr;
+    Ogre::InstanceManager* DebugMeshesGenerator::colourCubeInstances = nullptr;
     
 
-    bool Ogre3d::initOgre(SDL2Controller* sdl) {
-
-        sdlController = sdl;
+    static Ogre::Root* createRoot() {
         auto root = new Ogre::Root("", "");
         auto glRender = new Ogre::GLRenderSystem();
         root->addRenderSystem(glRender);	
         root->setRenderSystem(glRender);	
+        root->initialise(false); 
+        return root;
+    }
+
+    bool Ogre3d::initOgre(SDL2Controller* sdl) {
+
+        sdlController = sdl;
+        auto root = createRoot();
 
         Ogre::NameValuePairList params; 
         params["externalWindowHandle"] = Ogre::StringConverter::toString(sdl->getWindowIdentifier()); 
-        root->initialise(false); 
-        auto mWindow = root->createRenderWindow("View", 800, 600, false, &params); 
+        renderTarget = root->createRenderWindow("View", 800, 600, false, &params); 
+
+        initScene();
+        return true;
+    }
+
+    bool Ogre3d::initOgreHeadless(int width, int height) {
+
+        sdlController = nullptr;
+
+        //Without a display or render target support Ogre throws, which is an expected outcome on CI machines
+        try {
+            auto root = createRoot();
+
+            //GL render system creates its context with the first window. A hidden one is enough, it is never drawn into.
+            //Under Mesa(LIBGL_ALWAYS_SOFTWARE=1) this runs on a virtual display, or without any display on an EGL build of Ogre
+            Ogre::NameValuePairList params;
+            params["hidden"] = "true";
+            auto contextWindow = root->createRenderWindow("Headless", 1, 1, false, &params);
+            contextWindow->setAutoUpdated(false);
 
-        Ogre::SceneManager *sceneMgr = root->createSceneManager();
+            offscreenTexture = Ogre::TextureManager::getSingleton().createManual("Headless/Frame", Ogre::RGN_DEFAULT, Ogre::TEX_TYPE_2D,
+                width, height, 0, Ogre::PF_BYTE_RGBA, Ogre::TU_RENDERTARGET);
+            renderTarget = offscreenTexture->getBuffer()->getRenderTarget();
+        } catch(const Ogre::Exception& e) {
+            std::cerr << e.what() << '\n';
+            return false;
+        }
+        if(!renderTarget) {
+            return false;
+        }
+
+        initScene();
+        return true;
+    }
+
+    void Ogre3d::initScene() {
+        Ogre::SceneManager *sceneMgr = Ogre::Root::getSingletonPtr()->createSceneManager();
+        sceneManager = sceneMgr;
         
         mainCamera = std::make_unique<Ogre3dCameraControll>(sceneMgr, sdlController);      
         
 
-        Ogre::Viewport *vp = mWindow->addViewport(mainCamera->getCamera());
+        Ogre::Viewport *vp = renderTarget->addViewport(mainCamera->getCamera());
 
         sceneMgr->setAmbientLight(Ogre::ColourValue(0.5, 0.5, 0.5));       
-        return true;
+
+        sceneHierarchy.setSceneManager(sceneMgr);
+        graphicsLifecycle.setSceneManager(sceneMgr);
+        DebugMeshesGenerator::init(sceneMgr);
+        terrainBatcher = std::make_unique<TerrainRegionBatcher>(sceneMgr, &chunkBuffers, "Test/ColourTest");
     }
 
     void Ogre3d::ogreFrame(float delta) {
-        mainCamera->frame(delta);
+        auto start = std::chrono::high_resolution_clock::now();
+        if(sdlController) {
+            mainCamera->frame(delta);
+        }
+        mainCamera->updateVelocity(delta);
+        //New meshes are staged only while changes deferred by earlier frames leave budget for them
+        auto viewer = mainCamera->getPos();
+        terrainUploads.process(viewer, terrainBatcher->getPendingBytes(), [this](TerrainMeshResult& mesh, TerrainUploadQueue::Priority priority) {
+            return terrainBatcher->setMesh(std::move(mesh), priority == TerrainUploadQueue::EDIT);
+        });
+        terrainBatcher->update(viewer, terrainUploads.getBudget().bytes);
+
+        auto camera = mainCamera->getCamera();
+        occlusionCuller.beginFrame(camera->getProjectionMatrix() * camera->getViewMatrix(), camera->getRealPosition(), camera->getNearClipDistance());
+        terrainBatcher->cullOccluded(occlusionCuller);
+
+        //renderOneFrame updates the scene graph again, but finds nothing left to update
+        auto sceneStart = std::chrono::high_resolution_clock::now();
+        sceneManager->_updateSceneGraph(camera);
+        auto renderStart = std::chrono::high_resolution_clock::now();
         Ogre::Root::getSingletonPtr()->renderOneFrame(delta);
+        if(offscreenTexture) {
+            //Reading a pixel back waits for the GPU, otherwise only command submission would be timed
+            uint8_t pixel[4];
+            renderTarget->copyContentsToMemory(Ogre::Box(0, 0, 1, 1), Ogre::PixelBox(1, 1, 1, Ogre::PF_BYTE_RGBA, pixel));
+        }
+        auto renderEnd = std::chrono::high_resolution_clock::now();
+
+        graphicsLifecycle.processPending(maxDestructionsPerFrame);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        lastFrameTimings.sceneUpdateSeconds = std::chrono::duration<double>(renderStart - sceneStart).count();
+        lastFrameTimings.renderSeconds = std::chrono::duration<double>(renderEnd - renderStart).count();
+        lastFrameTimings.cpuSeconds = std::chrono::duration<double>(end - start).count() - lastFrameTimings.renderSeconds;
     }    
 
     void Ogre3d::ogreShutdown() {
+        terrainBatcher.reset();
+        graphicsLifecycle.destroyAll();
+        sceneHierarchy.clear();
+        chunkBuffers.clear();
     }
 
     Ogre3dCameraControll* Ogre3d::getCamera() const{
         return mainCamera.get();
     }
 
+    Ogre3d::FrameTimings Ogre3d::getLastFrameTimings() const {
+        return lastFrameTimings;
+    }
+
+    bool Ogre3d::saveFrame(const std::string& path) const {
+        auto width = renderTarget->getWidth();
+        auto height = renderTarget->getHeight();
+        std::vector<uint8_t> pixels(width * height * 3);
+        renderTarget->copyContentsToMemory(Ogre::Box(0, 0, width, height), Ogre::PixelBox(width, height, 1, Ogre::PF_BYTE_RGB, pixels.data()));
+
+        std::ofstream file(path, std::ios::binary);
+        if(!file) {
+            return false;
+        }
+        file << "P6\n" << width << " " << height << "\n255\n";
+        file.write((const char*)pixels.data(), pixels.size());
+        return (bool)file;
+    }
+
+    GraphicsObject Ogre3d::terrainMesh(const TerrainMeshView& mesh) {
+        return GraphicsObject(DebugMeshesGenerator::putTerrainMesh(mesh, chunkBuffers, graphicsLifecycle), &graphicsLifecycle);
+    }
+
+    void Ogre3d::updateTerrainMesh(GraphicsObject& object, const TerrainMeshView& mesh) {
+        if(object.sceneNode) {
+            DebugMeshesGenerator::updateTerrainMesh(object.sceneNode, mesh, chunkBuffers);
+        }
+    }
+
+    ChunkBufferPool::Stats Ogre3d::getChunkBufferStats() const {
+        return chunkBuffers.getStats();
+    }
+
+    GraphicsLifecycle::Stats Ogre3d::getGraphicsStats() const {
+        return graphicsLifecycle.getStats();
+    }
+
+    SceneNodeHierarchy& Ogre3d::getSceneHierarchy() {
+        return sceneHierarchy;
+    }
+
+    TerrainRegionBatcher* Ogre3d::getTerrainBatcher() const {
+        return terrainBatcher.get();
+    }
+
+    void Ogre3d::queueTerrainMesh(TerrainMeshResult mesh, TerrainUploadQueue::Priority priority) {
+        terrainUploads.submit(std::move(mesh), priority);
+    }
+
+    void Ogre3d::evictTerrainMesh(Vec3Int blockPos, int lod) {
+        terrainUploads.cancel(blockPos, lod);
+        terrainBatcher->removeBlock(blockPos, lod);
+    }
+
+    TerrainUploadQueue& Ogre3d::getTerrainUploads() {
+        return terrainUploads;
+    }
+
+    void Ogre3d::setOcclusionCulling(OcclusionCuller::Settings settings) {
+        occlusionCuller = OcclusionCuller(settings);
+    }
+
+    OcclusionCuller::Stats Ogre3d::getOcclusionStats() const {
+        return occlusionCuller.getStats();
+    }
+
     GraphicsObject Ogre3d::testCube(float x, float y, float z, float size, Ogre::ColourValue color) {
-        auto sceneNode = DebugMeshesGenerator::putTestCube(Ogre::Vector3(x, y, z), Ogre::Vector3(size), color);
-        return GraphicsObject(sceneNode);
+        auto sceneNode = DebugMeshesGenerator::putTestCube(graphicsLifecycle, Ogre::Vector3(x, y, z), Ogre::Vector3(size), color);
+        return GraphicsObject(sceneNode, &graphicsLifecycle);
     };
 
 
@@ -4,46 +4,172 @@
 #include <RenderSystems/GL/OgreGLRenderSystem.h>
 #include <SystemServices/SDL2Controller/SDL2Controller.hpp>
 #include <SystemServices/Ogre3d/Ogre3dCameraControl/Ogre3dCameraControl.hpp>
+#include <SystemServices/Ogre3d/ChunkBufferPool/ChunkBufferPool.hpp>
+#include <SystemServices/Ogre3d/GraphicsLifecycle/GraphicsLifecycle.hpp>
+#include <SystemServices/Ogre3d/OcclusionCuller/OcclusionCuller.hpp>
+#include <SystemServices/Ogre3d/SceneNodeHierarchy/SceneNodeHierarchy.hpp>
+#include <SystemServices/Ogre3d/TerrainRegionBatcher/TerrainRegionBatcher.hpp>
+#include <SystemServices/Ogre3d/TerrainUploadQueue/TerrainUploadQueue.hpp>
+#include <Terrain/TerrainMeshing/TerrainMeshing.hpp>
 #include <memory>
+#include <utility>
 
 namespace fluorite
 {
 
     /**
      * Represents a graphical objects. GrapgicsObjects can be created via Ogre3D. They are controlled mostly through
-     * interactions with Ogre3d
+     * interactions with Ogre3d. Move only, since the scene node behind it is recycled for another object once
+     * released, and a copy left behind would control that one
      */
     class GraphicsObject {
     private:
         Ogre::SceneNode* sceneNode;
+        GraphicsLifecycle* lifecycle;
 
-        GraphicsObject(Ogre::SceneNode* _sceneNode) : sceneNode(_sceneNode) {}
+        GraphicsObject(Ogre::SceneNode* _sceneNode, GraphicsLifecycle* _lifecycle) : sceneNode(_sceneNode), lifecycle(_lifecycle) {}
         friend class Ogre3d;
 
     public:
+        GraphicsObject(GraphicsObject&& other) : sceneNode(std::exchange(other.sceneNode, nullptr)), lifecycle(other.lifecycle) {}
+        GraphicsObject(const GraphicsObject&) = delete;
+        GraphicsObject& operator=(const GraphicsObject&) = delete;
+        GraphicsObject& operator=(GraphicsObject&&) = delete;
 
+        /**
+         * Object stays in the scene until the end of the frame, then it is torn down or recycled.
+         * Destroying it again, or destroying a moved from object, does nothing
+         */
         void destroy() {
-            sceneNode->destroyAllChildrenAndObjects();
+            if(sceneNode) {
+                lifecycle->release(std::exchange(sceneNode, nullptr));
+            }
+        }
+
+        /**
+         * Does nothing once destroyed
+         */
+        void setPosition(Ogre::Vector3 pos) {
+            if(sceneNode) {
+                lifecycle->move(sceneNode, pos);
+            }
         }
     };
 
 
     /**
-     * Initializes Ogre3D and allows for creation and management of GraphicsObjects and cameras
+     * Initializes Ogre3D and allows for creation and management of GraphicsObjects and cameras. Not thread safe,
+     * everything including initialization must happen on one thread(see RenderThread)
      */
     class Ogre3d
     {
+    public:
+        struct FrameTimings {
+            //Camera, uploads, batching, scene graph update and deferred destruction
+            double cpuSeconds = 0;
+            //Transforms and bounds of changed scene nodes, part of cpuSeconds
+            double sceneUpdateSeconds = 0;
+            //renderOneFrame, in headless mode including the wait for the GPU to finish the frame
+            double renderSeconds = 0;
+        };
+
     private: 
-        SDL2Controller* sdlController;
+        SDL2Controller* sdlController = nullptr;
+        Ogre::SceneManager* sceneManager = nullptr;
+        //Window, or offscreen texture in headless mode
+        Ogre::RenderTarget* renderTarget = nullptr;
+        Ogre::TexturePtr offscreenTexture;
+        FrameTimings lastFrameTimings;
         std::unique_ptr<Ogre3dCameraControll> mainCamera;
+        ChunkBufferPool chunkBuffers;
+        SceneNodeHierarchy sceneHierarchy;
+        GraphicsLifecycle graphicsLifecycle{&chunkBuffers, &sceneHierarchy};
+        //Releases buffers into chunkBuffers, so it is declared after it
+        std::unique_ptr<TerrainRegionBatcher> terrainBatcher;
+        TerrainUploadQueue terrainUploads;
+        OcclusionCuller occlusionCuller;
+
+        //Camera, viewport and everything drawn, once renderTarget exists
+        void initScene();
+
     public:
 
         bool initOgre(SDL2Controller* sdl);
+
+        /**
+         * Renders into an offscreen texture of given size instead of a window, for unattended runs. Nothing reads input,
+         * the camera is moved only through getCamera()->setPos and lookAt
+         */
+        bool initOgreHeadless(int width, int height);
+
         void ogreFrame(float delta);
         void ogreShutdown();
 
         Ogre3dCameraControll* getCamera() const;
 
+        FrameTimings getLastFrameTimings() const;
+
+        /**
+         * Writes the last rendered frame as binary PPM
+         * @return false if file couldn't be written
+         */
+        bool saveFrame(const std::string& path) const;
+
+        /**
+         * Released GraphicsObjects torn down at the end of every frame, the rest waits for the next frame
+         */
+        int maxDestructionsPerFrame = 256;
+
+        /**
+         * Shows mesh produced by TerrainMeshingService, in either vertex format. Hardware buffers come from a pool
+         * and return to it when the object is destroyed
+         */
+        GraphicsObject terrainMesh(const TerrainMeshView& mesh);
+
+        /**
+         * Replaces geometry of an object made by terrainMesh. New geometry is written into the existing buffers when it fits
+         */
+        void updateTerrainMesh(GraphicsObject& object, const TerrainMeshView& mesh);
+
+        ChunkBufferPool::Stats getChunkBufferStats() const;
+
+        /**
+         * Live Ogre objects behind GraphicsObjects, a steadily growing count means a leak
+         */
+        GraphicsLifecycle::Stats getGraphicsStats() const;
+
+        /**
+         * Octree cells GraphicsObjects are placed into. A cell hidden through it hides every object inside at once
+         */
+        SceneNodeHierarchy& getSceneHierarchy();
+
+        /**
+         * Alternative to terrainMesh for distant terrain, meshes of nearby blocks of the same LoD are drawn as one
+         * region batch. Available after initOgre, changes are uploaded at the start of every frame
+         */
+        TerrainRegionBatcher* getTerrainBatcher() const;
+
+        /**
+         * Stages mesh for the terrain batcher. Staged meshes are uploaded nearest to the camera first, within
+         * the budget of the upload queue every frame. Meshes of edits are uploaded on the next frame regardless of it
+         */
+        void queueTerrainMesh(TerrainMeshResult mesh, TerrainUploadQueue::Priority priority = TerrainUploadQueue::STREAMED);
+
+        /**
+         * Removes block from the terrain batcher, including a mesh still waiting for upload
+         */
+        void evictTerrainMesh(Vec3Int blockPos, int lod);
+
+        TerrainUploadQueue& getTerrainUploads();
+
+        /**
+         * Regions of the terrain batcher hidden behind nearby terrain are not drawn. Occluders come with meshes,
+         * see TerrainMeshingService::setOccluderExtraction. maxOccluders of 0 turns culling off
+         */
+        void setOcclusionCulling(OcclusionCuller::Settings settings);
+
+        OcclusionCuller::Stats getOcclusionStats() const;
+
         GraphicsObject testCube(float x, float y, float z, float size, Ogre::ColourValue color = Ogre::ColourValue::White);
 
     };
@@ -35,6 +35,16 @@ namespace fluorite {
         return camera->getRealPosition();
     }
 
+    Ogre::Vector3 Ogre3dCameraControll::getVelocity() const {
+        return velocity;
+    }
+
+    void Ogre3dCameraControll::updateVelocity(float delta) {
+        auto pos = getPos();
+        velocity = lastPos && delta > 0 ? (pos - *lastPos) / delta : Ogre::Vector3::ZERO;
+        lastPos = pos;
+    }
+
 
     void Ogre3dCameraControll::frame(float delta) {
 
@@ -58,9 +68,8 @@ namespace fluorite {
         flyDir.normalise();
         flyDir = flyDir * delta * speed;
         
-        currPos = currPos + moveDir + flyDir;
-
-        camera->getParentNode()->setPosition(currPos);
+        auto newPos = currPos + moveDir + flyDir;
+        camera->getParentNode()->setPosition(newPos);
 
     }
 
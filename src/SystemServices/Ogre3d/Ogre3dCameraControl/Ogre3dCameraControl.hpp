@@ -2,6 +2,7 @@
 
 #include <Ogre.h>
 #include <SystemServices/SDL2Controller/SDL2Controller.hpp>
+#include <optional>
 
 namespace fluorite {
 
@@ -12,6 +13,8 @@ namespace fluorite {
             SDL2Controller* controller;
             float speed = 4;
             float sensitivity = 0.5f;
+            Ogre::Vector3 velocity = Ogre::Vector3::ZERO;
+            std::optional<Ogre::Vector3> lastPos;
 
         public: 
 
@@ -21,6 +24,15 @@ namespace fluorite {
         Ogre::Camera* getCamera();
 
         Ogre::Vector3 getPos() const;
+        /**
+         * Velocity of the camera over the last frame, in units per second. Covers every way of moving it, input as well as setPos
+         */
+        Ogre::Vector3 getVelocity() const;
+
+        /**
+         * Measures velocity from the distance moved since the previous call, once per frame
+         */
+        void updateVelocity(float delta);
 
         
         Ogre3dCameraControll& lookAt(Ogre::Vector3 pos);
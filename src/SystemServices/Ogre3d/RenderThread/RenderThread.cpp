@@ -0,0 +1,217 @@
+#include <SystemServices/Ogre3d/RenderThread/RenderThread.hpp>
+
+namespace fluorite {
+
+    RenderThread::~RenderThread() {
+        stop();
+    }
+
+    bool RenderThread::start(SDL2Controller* sdl) {
+        controller = sdl;
+        input = *sdl;
+        thread = std::thread([this]() { threadLoop(); });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return startup != STARTING; });
+        if(startup == FAILED) {
+            lock.unlock();
+            thread.join();
+            if(error) {
+                std::rethrow_exception(error);
+            }
+            return false;
+        }
+        running = true;
+        return true;
+    }
+
+    void RenderThread::threadLoop() {
+        bool initialized = false;
+        try {
+            initialized = ogre3d->initOgre(&input);
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            startup = initialized ? STARTED : FAILED;
+        }
+        changed.notify_all();
+        if(!initialized) {
+            return;
+        }
+
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this]() { return busy || stopping; });
+                if(!busy) {
+                    break;
+                }
+            }
+
+            auto newState = State();
+            try {
+                input = submitted.input;
+                for(auto& command : submitted.commands) {
+                    apply(command);
+                }
+                submitted.commands.clear();
+                ogre3d->ogreFrame(submitted.delta);
+
+                newState.cameraPos = ogre3d->getCamera()->getPos();
+                newState.timings = ogre3d->getLastFrameTimings();
+                newState.graphics = ogre3d->getGraphicsStats();
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                newState.frames = state.frames + 1;
+                state = newState;
+                busy = false;
+            }
+            changed.notify_all();
+        }
+
+        //Ids are only meaningful to this thread, Ogre objects behind them go away with the scene
+        objects.clear();
+        ogre3d->ogreShutdown();
+    }
+
+    void RenderThread::apply(SceneCommand& command) {
+        switch(command.type) {
+            case SceneCommand::CREATE_CUBE: {
+                auto pos = command.position;
+                objects.emplace(command.object, ogre3d->testCube(pos.x, pos.y, pos.z, command.size, command.colour));
+                break;
+            }
+            case SceneCommand::CREATE_TERRAIN_MESH: {
+                objects.emplace(command.object, ogre3d->terrainMesh(*command.mesh));
+                break;
+            }
+            case SceneCommand::UPDATE_TERRAIN_MESH: {
+                auto object = objects.find(command.object);
+                if(object != objects.end()) {
+                    ogre3d->updateTerrainMesh(object->second, *command.mesh);
+                }
+                break;
+            }
+            case SceneCommand::MOVE: {
+                auto object = objects.find(command.object);
+                if(object != objects.end()) {
+                    object->second.setPosition(command.position);
+                }
+                break;
+            }
+            case SceneCommand::DESTROY: {
+                auto object = objects.find(command.object);
+                if(object != objects.end()) {
+                    object->second.destroy();
+                    objects.erase(object);
+                }
+                break;
+            }
+            case SceneCommand::QUEUE_TERRAIN_MESH: {
+                ogre3d->queueTerrainMesh(std::move(*command.mesh), command.priority);
+                break;
+            }
+            case SceneCommand::EVICT_TERRAIN_MESH: {
+                ogre3d->evictTerrainMesh(command.blockPos, command.lod);
+                break;
+            }
+        }
+    }
+
+    void RenderThread::submitFrame(float delta) {
+        if(!running) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        //Only point where the game thread waits for rendering, the previous frame must be done with its buffer
+        changed.wait(lock, [this]() { return !busy; });
+        if(error) {
+            auto rethrown = error;
+            error = nullptr;
+            std::rethrow_exception(rethrown);
+        }
+
+        recording.delta = delta;
+        recording.input = *controller;
+        std::swap(recording, submitted);
+        recording.commands.clear();
+        busy = true;
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    void RenderThread::stop() {
+        if(!thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+        running = false;
+        recording.commands.clear();
+    }
+
+    RenderThread::State RenderThread::getState() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return state;
+    }
+
+    uint32_t RenderThread::record(SceneCommand command) {
+        auto object = command.object;
+        if(running) {
+            recording.commands.push_back(std::move(command));
+        }
+        return object;
+    }
+
+    uint32_t RenderThread::createCube(Ogre::Vector3 pos, float size, Ogre::ColourValue colour) {
+        auto command = SceneCommand({SceneCommand::CREATE_CUBE, nextObject++, pos, size, colour});
+        return record(std::move(command));
+    }
+
+    uint32_t RenderThread::createTerrainMesh(TerrainMeshResult mesh) {
+        auto command = SceneCommand({SceneCommand::CREATE_TERRAIN_MESH, nextObject++});
+        command.mesh = std::make_shared<TerrainMeshResult>(std::move(mesh));
+        return record(std::move(command));
+    }
+
+    void RenderThread::updateTerrainMesh(uint32_t object, TerrainMeshResult mesh) {
+        auto command = SceneCommand({SceneCommand::UPDATE_TERRAIN_MESH, object});
+        command.mesh = std::make_shared<TerrainMeshResult>(std::move(mesh));
+        record(std::move(command));
+    }
+
+    void RenderThread::move(uint32_t object, Ogre::Vector3 pos) {
+        record(SceneCommand({SceneCommand::MOVE, object, pos}));
+    }
+
+    void RenderThread::destroy(uint32_t object) {
+        record(SceneCommand({SceneCommand::DESTROY, object}));
+    }
+
+    void RenderThread::queueTerrainMesh(TerrainMeshResult mesh, TerrainUploadQueue::Priority priority) {
+        auto command = SceneCommand({SceneCommand::QUEUE_TERRAIN_MESH});
+        command.mesh = std::make_shared<TerrainMeshResult>(std::move(mesh));
+        command.priority = priority;
+        record(std::move(command));
+    }
+
+    void RenderThread::evictTerrainMesh(Vec3Int blockPos, int lod) {
+        auto command = SceneCommand({SceneCommand::EVICT_TERRAIN_MESH});
+        command.blockPos = blockPos;
+        command.lod = lod;
+        record(std::move(command));
+    }
+
+}
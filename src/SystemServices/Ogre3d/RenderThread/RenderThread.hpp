@@ -0,0 +1,132 @@
+#pragma once
+
+#include <SystemServices/Ogre3d/Ogre3d.hpp>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fluorite {
+
+    /**
+     * Change of the scene, recorded on the game thread and applied on the render thread
+     */
+    struct SceneCommand {
+        enum Type {
+            CREATE_CUBE,
+            CREATE_TERRAIN_MESH,
+            UPDATE_TERRAIN_MESH,
+            MOVE,
+            DESTROY,
+            //Terrain batcher, see Ogre3d::queueTerrainMesh and evictTerrainMesh
+            QUEUE_TERRAIN_MESH,
+            EVICT_TERRAIN_MESH,
+        };
+
+        Type type;
+        //Object created or changed, unused by batcher commands
+        uint32_t object = 0;
+        Ogre::Vector3 position = Ogre::Vector3::ZERO;
+        float size = 1;
+        Ogre::ColourValue colour = Ogre::ColourValue::White;
+        std::shared_ptr<TerrainMeshResult> mesh;
+        Vec3Int blockPos;
+        int lod = 0;
+        TerrainUploadQueue::Priority priority = TerrainUploadQueue::STREAMED;
+    };
+
+    /**
+     * Runs Ogre3d on its own thread, so the game thread simulates frame N+1 while frame N is rendered. Every Ogre call,
+     * including initialization and shutdown, happens on the render thread. Game thread records scene changes into one
+     * command buffer while the render thread applies the other one, buffers are swapped by submitFrame.
+     * Objects are referred to by ids handed out immediately, the Ogre objects behind them exist from the next frame.
+     * All methods are meant for the game thread
+     */
+    class RenderThread {
+        public:
+            /**
+             * Copy of render thread state, published after every frame
+             */
+            struct State {
+                Ogre::Vector3 cameraPos = Ogre::Vector3::ZERO;
+                Ogre3d::FrameTimings timings;
+                GraphicsLifecycle::Stats graphics;
+                int64_t frames = 0;
+            };
+
+        private:
+            struct Frame {
+                float delta = 0;
+                std::vector<SceneCommand> commands;
+                //Input is copied with the frame, camera never reads the controller the game thread is updating
+                SDL2Controller input;
+            };
+
+            Ogre3d* ogre3d;
+            SDL2Controller* controller = nullptr;
+            std::thread thread;
+            std::mutex mutex;
+            std::condition_variable changed;
+
+            //Game thread only
+            Frame recording;
+            uint32_t nextObject = 1;
+            bool running = false;
+
+            //Owned by the render thread while busy, swapped with recording otherwise
+            Frame submitted;
+
+            //Guarded by mutex
+            enum {STARTING, STARTED, FAILED} startup = STARTING;
+            bool busy = false;
+            bool stopping = false;
+            std::exception_ptr error;
+            State state;
+
+            //Render thread only
+            SDL2Controller input;
+            std::unordered_map<uint32_t, GraphicsObject> objects;
+
+            void threadLoop();
+            void apply(SceneCommand& command);
+            uint32_t record(SceneCommand command);
+
+        public:
+            RenderThread(Ogre3d* ogre3d) : ogre3d(ogre3d) {}
+            ~RenderThread();
+
+            RenderThread(const RenderThread&) = delete;
+            RenderThread& operator=(const RenderThread&) = delete;
+
+            /**
+             * Starts the thread and initializes Ogre3d on it, returns once initialization is done
+             * @return false if initialization failed
+             */
+            bool start(SDL2Controller* sdl);
+
+            /**
+             * Hands commands recorded since the last call to the render thread, together with current input.
+             * Waits only while the previous frame is still being rendered. Rethrows exception thrown on the render thread
+             */
+            void submitFrame(float delta);
+
+            /**
+             * Waits for the frame being rendered and shuts Ogre3d down on the render thread. Commands recorded
+             * afterwards are ignored
+             */
+            void stop();
+
+            State getState();
+
+            uint32_t createCube(Ogre::Vector3 pos, float size, Ogre::ColourValue colour = Ogre::ColourValue::White);
+            uint32_t createTerrainMesh(TerrainMeshResult mesh);
+            void updateTerrainMesh(uint32_t object, TerrainMeshResult mesh);
+            void move(uint32_t object, Ogre::Vector3 pos);
+            void destroy(uint32_t object);
+
+            void queueTerrainMesh(TerrainMeshResult mesh, TerrainUploadQueue::Priority priority = TerrainUploadQueue::STREAMED);
+            void evictTerrainMesh(Vec3Int blockPos, int lod);
+    };
+
+}
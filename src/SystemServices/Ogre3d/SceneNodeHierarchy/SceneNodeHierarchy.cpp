@@ -0,0 +1,124 @@
+#include <SystemServices/Ogre3d/SceneNodeHierarchy/SceneNodeHierarchy.hpp>
+
+#include <cmath>
+
+namespace fluorite {
+
+    void SceneNodeHierarchy::setTerrainLayout(int chunkSize, int minSubchunkSize, float scale) {
+        leafVoxels = minSubchunkSize;
+        worldScale = scale;
+        levels = 1;
+        while((minSubchunkSize << (levels - 1)) < chunkSize) {
+            levels++;
+        }
+    }
+
+    int SceneNodeHierarchy::getLevel(int subchunkSize) const {
+        int level = 0;
+        while(level < levels - 1 && (leafVoxels << level) < subchunkSize) {
+            level++;
+        }
+        return level;
+    }
+
+    SceneNodeHierarchy::CellKey SceneNodeHierarchy::getKey(Ogre::Vector3 pos, int level) const {
+        //In whole voxels, so objects placed on subchunk corners land in the cell of their subchunk despite float error
+        auto voxel = Vec3Int((int)std::lround(pos.x / worldScale), (int)std::lround(pos.y / worldScale), (int)std::lround(pos.z / worldScale));
+        auto size = leafVoxels << level;
+        return {level, Vec3Int(div_floor(voxel.x, size), div_floor(voxel.y, size), div_floor(voxel.z, size))};
+    }
+
+    SceneNodeHierarchy::CellKey SceneNodeHierarchy::getParentKey(const CellKey& key) {
+        auto& coords = key.second;
+        return {key.first + 1, Vec3Int(div_floor(coords.x, 2), div_floor(coords.y, 2), div_floor(coords.z, 2))};
+    }
+
+    Ogre::SceneNode* SceneNodeHierarchy::getParentNode(const CellKey& key) {
+        if(key.first + 1 >= levels) {
+            return sceneManager->getRootSceneNode();
+        }
+        return cells.at(getParentKey(key)).node;
+    }
+
+    Ogre::SceneNode* SceneNodeHierarchy::acquire(Ogre::Vector3 pos) {
+        //Top-down, so parents exist when their children are created
+        for(int level = levels - 1; level >= 0; level--) {
+            auto key = getKey(pos, level);
+            auto& cell = cells[key];
+            if(!cell.node) {
+                cell.node = getParentNode(key)->createChildSceneNode();
+            }
+            cell.objects++;
+            if(level == 0) {
+                leaves[cell.node] = key;
+                return cell.node;
+            }
+        }
+        return nullptr;
+    }
+
+    void SceneNodeHierarchy::release(Ogre::SceneNode* leaf) {
+        auto leafKey = leaves.find(leaf);
+        if(leafKey == leaves.end()) {
+            return;
+        }
+        auto key = leafKey->second;
+        for(int level = 0; level < levels; level++) {
+            auto cell = cells.find(key);
+            if(--cell->second.objects == 0) {
+                if(level == 0) {
+                    leaves.erase(leafKey);
+                }
+                //Hidden cell is already detached from its parent
+                if(auto parent = cell->second.node->getParent()) {
+                    parent->removeChild(cell->second.node);
+                }
+                sceneManager->destroySceneNode(cell->second.node);
+                cells.erase(cell);
+            }
+            key = getParentKey(key);
+        }
+    }
+
+    void SceneNodeHierarchy::setCellVisible(Ogre::Vector3 pos, int level, bool visible) {
+        auto key = getKey(pos, level);
+        auto cell = cells.find(key);
+        if(cell == cells.end() || cell->second.hidden == !visible) {
+            return;
+        }
+        cell->second.hidden = !visible;
+        if(visible) {
+            getParentNode(key)->addChild(cell->second.node);
+        } else {
+            getParentNode(key)->removeChild(cell->second.node);
+        }
+    }
+
+    void SceneNodeHierarchy::clear() {
+        //Children first, destroying a node doesn't destroy its children
+        for(int level = 0; level < levels; level++) {
+            for(auto cell = cells.begin(); cell != cells.end();) {
+                if(cell->first.first != level) {
+                    cell++;
+                    continue;
+                }
+                if(auto parent = cell->second.node->getParent()) {
+                    parent->removeChild(cell->second.node);
+                }
+                sceneManager->destroySceneNode(cell->second.node);
+                cell = cells.erase(cell);
+            }
+        }
+        leaves.clear();
+    }
+
+    SceneNodeHierarchy::Stats SceneNodeHierarchy::getStats() const {
+        auto result = Stats();
+        result.cells = (int)cells.size();
+        for(auto& [key, cell] : cells) {
+            result.hiddenCells += cell.hidden;
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Ogre.h>
+#include <Terrain/Terrain.hpp>
+#include <map>
+#include <unordered_map>
+
+namespace fluorite {
+
+    /**
+     * Octree of empty scene nodes that chunk nodes are attached to instead of the scene root. Cells mirror subchunks of
+     * the terrain map(see setTerrainLayout): the smallest cells are minimal subchunks, every level doubles them and the
+     * top level cells are data chunks. So Ogre culls a whole cell against the camera by the bounds of its node, skips
+     * unchanged cells when updating the scene graph, and a terrain node is hidden by hiding its cell. Cells are created
+     * on first use and destroyed with their last object. Cell nodes are never transformed, children keep world positions
+     */
+    class SceneNodeHierarchy {
+        public:
+            struct Stats {
+                int cells = 0;
+                int hiddenCells = 0;
+            };
+
+        private:
+            //(level, cell coordinates)
+            using CellKey = std::pair<int, Vec3Int>;
+
+            struct Cell {
+                Ogre::SceneNode* node;
+                //Objects in this cell and all cells below it
+                int objects = 0;
+                bool hidden = false;
+            };
+
+            Ogre::SceneManager* sceneManager = nullptr;
+            //Single level of unit cells until setTerrainLayout
+            int leafVoxels = 1;
+            float worldScale = 1;
+            int levels = 1;
+            std::map<CellKey, Cell> cells;
+            std::unordered_map<Ogre::SceneNode*, CellKey> leaves;
+
+            CellKey getKey(Ogre::Vector3 pos, int level) const;
+            static CellKey getParentKey(const CellKey& key);
+            Ogre::SceneNode* getParentNode(const CellKey& key);
+
+        public:
+            SceneNodeHierarchy() = default;
+
+            SceneNodeHierarchy(const SceneNodeHierarchy&) = delete;
+            SceneNodeHierarchy& operator=(const SceneNodeHierarchy&) = delete;
+
+            void setSceneManager(Ogre::SceneManager* manager) {
+                sceneManager = manager;
+            }
+
+            /**
+             * Sizes cells after the terrain map objects are placed for. Must be called before the first acquire
+             * @param chunkSize data chunk edge in voxels(TerrainMap::getDatachunkSize), size of the top level cells
+             * @param minSubchunkSize smallest subchunk edge in voxels(TerrainMap::getMinChunkSize), size of the leaf cells
+             * @param scale world units per voxel
+             */
+            void setTerrainLayout(int chunkSize, int minSubchunkSize, float scale);
+
+            /**
+             * Smallest cell containing position, created with its parents if needed. Counts one object until release
+             */
+            Ogre::SceneNode* acquire(Ogre::Vector3 pos);
+
+            /**
+             * Object of a cell returned by acquire is gone, empty cells are destroyed
+             */
+            void release(Ogre::SceneNode* leaf);
+
+            /**
+             * Level of cells matching subchunks of given size in voxels
+             */
+            int getLevel(int subchunkSize) const;
+
+            /**
+             * Hides or shows the cell of given level containing position, together with everything below it, by
+             * detaching a single node. Cells that don't exist are ignored
+             */
+            void setCellVisible(Ogre::Vector3 pos, int level, bool visible);
+
+            /**
+             * Destroys all cell nodes. Objects must be detached from them first
+             */
+            void clear();
+
+            Stats getStats() const;
+    };
+
+}
@@ -0,0 +1,322 @@
+#include <SystemServices/Ogre3d/TerrainRegionBatcher/TerrainRegionBatcher.hpp>
+
+#include <cstddef>
+
+namespace fluorite {
+
+    TerrainRegionBatcher::TerrainRegionBatcher(Ogre::SceneManager* sceneManager, ChunkBufferPool* pool, std::string materialName, int regionBlocks)
+        : sceneManager(sceneManager), pool(pool), materialName(std::move(materialName)), regionBlocks(regionBlocks) {}
+
+    TerrainRegionBatcher::~TerrainRegionBatcher() {
+        for(auto& [key, region] : regions) {
+            destroy(region);
+        }
+    }
+
+    Vec3Int TerrainRegionBatcher::getRegionPos(Vec3Int blockPos, int lod) const {
+        return blockPos.align(regionBlocks * TerrainDataBlock::getLevelBlockSize(lod));
+    }
+
+    Ogre::AxisAlignedBox TerrainRegionBatcher::getRegionBox(const Region& region) const {
+        auto pos = OgreVecFromV3I(region.pos);
+        return Ogre::AxisAlignedBox(pos, pos + Ogre::Vector3(regionBlocks * TerrainDataBlock::getLevelBlockSize(region.lod)));
+    }
+
+    size_t TerrainRegionBatcher::getUploadBytes(const Region& region) const {
+        size_t bytes = 0;
+        for(auto& [key, member] : region.members) {
+            if(region.needsRebuild || member.needsPatch) {
+                bytes += member.vertices.size() * sizeof(TransvoxelPolygonizatorVertex) + member.indices.size() * sizeof(uint32_t);
+            }
+        }
+        return bytes;
+    }
+
+    size_t TerrainRegionBatcher::setMesh(TerrainMeshResult&& mesh, bool edit) {
+        auto key = std::make_pair(mesh.lod, getRegionPos(mesh.blockPos, mesh.lod));
+        auto region = regions.find(key);
+        auto before = region != regions.end() ? getUploadBytes(region->second) : 0;
+        stage(mesh);
+        region = regions.find(key);
+        if(region == regions.end()) {
+            return 0;
+        }
+        region->second.hasEdit |= edit;
+        auto after = getUploadBytes(region->second);
+        return after > before ? after - before : 0;
+    }
+
+    void TerrainRegionBatcher::stage(TerrainMeshResult& mesh) {
+        if(mesh.indices.empty() && mesh.packedIndices.empty()) {
+            removeMesh(mesh.blockPos, mesh.lod, mesh.part);
+            return;
+        }
+        //Block is meshed either whole or in two parts, never both
+        if(mesh.part == TransvoxelPolygonizator::WHOLE) {
+            removeMesh(mesh.blockPos, mesh.lod, TransvoxelPolygonizator::INTERIOR);
+            removeMesh(mesh.blockPos, mesh.lod, TransvoxelPolygonizator::BOUNDARY);
+        } else {
+            removeMesh(mesh.blockPos, mesh.lod, TransvoxelPolygonizator::WHOLE);
+        }
+        bool packed = !mesh.packedIndices.empty();
+
+        auto regionPos = getRegionPos(mesh.blockPos, mesh.lod);
+        auto& region = regions[{mesh.lod, regionPos}];
+        region.pos = regionPos;
+        region.lod = mesh.lod;
+
+        auto inserted = region.members.try_emplace({mesh.blockPos, mesh.part});
+        auto& member = inserted.first->second;
+        auto oldVertices = member.vertices.size();
+        auto oldIndices = member.indices.size();
+
+        //Full format already has the region layout, it only has to be moved into the region
+        auto offset = OgreVecFromV3I(Vec3Int(mesh.blockPos).substract(regionPos));
+        if(packed) {
+            member.vertices.clear();
+            for(auto& vertex : mesh.packedVertices) {
+                member.vertices.push_back(TransvoxelPolygonizatorVertex(offset + vertex.getPosition(mesh.lod), vertex.getNormal()));
+            }
+            member.indices.assign(mesh.packedIndices.begin(), mesh.packedIndices.end());
+        } else {
+            member.vertices = std::move(mesh.vertices);
+            for(auto& vertex : member.vertices) {
+                vertex.pos += offset;
+            }
+            member.indices = std::move(mesh.indices);
+        }
+
+        //Boundary meshes come without occluders, those of the block are kept by its interior member
+        auto voxel = (float)(TerrainDataBlock::getLevelBlockSize(mesh.lod) / TerrainDataBlock::getBlockSize());
+        member.occluders.clear();
+        for(auto& box : mesh.occluders) {
+            member.occluders.push_back(Ogre::AxisAlignedBox(offset + OgreVecFromV3I(box.lo) * voxel, offset + OgreVecFromV3I(box.hi) * voxel));
+        }
+
+        //Same sized geometry fits into the range the member already has
+        if(inserted.second || oldVertices != member.vertices.size() || oldIndices != member.indices.size()) {
+            region.needsRebuild = true;
+        } else {
+            member.needsPatch = true;
+            region.needsPatch = true;
+        }
+    }
+
+    void TerrainRegionBatcher::removeMesh(Vec3Int blockPos, int lod, TransvoxelPolygonizator::BlockPart part) {
+        auto region = regions.find({lod, getRegionPos(blockPos, lod)});
+        if(region == regions.end() || region->second.members.erase({blockPos, part}) == 0) {
+            return;
+        }
+        region->second.needsRebuild = true;
+    }
+
+    void TerrainRegionBatcher::removeBlock(Vec3Int blockPos, int lod) {
+        for(auto part : {TransvoxelPolygonizator::WHOLE, TransvoxelPolygonizator::INTERIOR, TransvoxelPolygonizator::BOUNDARY}) {
+            removeMesh(blockPos, lod, part);
+        }
+    }
+
+    size_t TerrainRegionBatcher::update(Ogre::Vector3 viewer, size_t byteBudget) {
+        //Emptied regions are dropped right away, that writes nothing
+        order.clear();
+        for(auto region = regions.begin(); region != regions.end();) {
+            if(region->second.members.empty()) {
+                destroy(region->second);
+                region = regions.erase(region);
+                continue;
+            }
+            if(region->second.needsRebuild || region->second.needsPatch) {
+                auto extent = (float)(regionBlocks * TerrainDataBlock::getLevelBlockSize(region->second.lod));
+                auto center = OgreVecFromV3I(region->second.pos) + Ogre::Vector3(extent * 0.5f);
+                order.push_back({center.squaredDistance(viewer), region});
+            }
+            region++;
+        }
+        std::sort(order.begin(), order.end(), [](auto& a, auto& b) {
+            return std::make_pair(!a.second->second.hasEdit, a.first) < std::make_pair(!b.second->second.hasEdit, b.first);
+        });
+
+        size_t written = 0;
+        stats.deferredRegions = 0;
+        for(auto& [distance, region] : order) {
+            auto bytes = getUploadBytes(region->second);
+            if(!region->second.hasEdit && written > 0 && written + bytes > byteBudget) {
+                stats.deferredRegions++;
+                continue;
+            }
+            if(region->second.needsRebuild) {
+                rebuild(region->second);
+            } else {
+                patch(region->second);
+            }
+            written += bytes;
+        }
+        stats.uploadedBytes += written;
+        stats.lastFrameBytes = written;
+        return written;
+    }
+
+    size_t TerrainRegionBatcher::getPendingBytes() const {
+        size_t bytes = 0;
+        for(auto& [key, region] : regions) {
+            bytes += getUploadBytes(region);
+        }
+        return bytes;
+    }
+
+    void TerrainRegionBatcher::rebuild(Region& region) {
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        for(auto& [pos, member] : region.members) {
+            member.vertexStart = vertexCount;
+            member.indexStart = indexCount;
+            member.needsPatch = false;
+            vertexCount += member.vertices.size();
+            indexCount += member.indices.size();
+        }
+
+        bool created = !region.mesh;
+        if(created) {
+            auto name = "TerrainRegion/" + std::to_string(meshCounter++);
+            region.mesh = Ogre::MeshManager::getSingleton().createManual(name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+            region.mesh->createSubMesh()->useSharedVertices = true;
+            region.mesh->sharedVertexData = new Ogre::VertexData();
+            //Layout must match TransvoxelPolygonizatorVertex
+            auto decl = region.mesh->sharedVertexData->vertexDeclaration;
+            decl->addElement(0, offsetof(TransvoxelPolygonizatorVertex, pos), Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+            decl->addElement(0, offsetof(TransvoxelPolygonizatorVertex, normal), Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+        }
+
+        //Buffers are kept while the region fits, so regions that only shrink or grow a little don't touch the pool
+        auto vertexData = region.mesh->sharedVertexData;
+        auto bind = vertexData->vertexBufferBinding;
+        Ogre::HardwareVertexBufferSharedPtr vbuf;
+        if(bind->isBufferBound(0)) {
+            vbuf = bind->getBuffer(0);
+        }
+        if(!vbuf || vbuf->getNumVertices() < vertexCount) {
+            pool->release(std::move(vbuf));
+            vbuf = pool->acquireVertexBuffer(sizeof(TransvoxelPolygonizatorVertex), vertexCount);
+            bind->setBinding(0, vbuf);
+        }
+        auto sub = region.mesh->getSubMesh(0);
+        auto& ibuf = sub->indexData->indexBuffer;
+        if(!ibuf || ibuf->getNumIndexes() < indexCount) {
+            pool->release(std::move(ibuf));
+            ibuf = pool->acquireIndexBuffer(Ogre::HardwareIndexBuffer::IT_32BIT, indexCount);
+        }
+
+        auto vertices = static_cast<TransvoxelPolygonizatorVertex*>(vbuf->lock(0, vertexCount * sizeof(TransvoxelPolygonizatorVertex), Ogre::HardwareBuffer::HBL_DISCARD));
+        auto indices = static_cast<uint32_t*>(ibuf->lock(0, indexCount * sizeof(uint32_t), Ogre::HardwareBuffer::HBL_DISCARD));
+        for(auto& [pos, member] : region.members) {
+            vertices = std::copy(member.vertices.begin(), member.vertices.end(), vertices);
+            for(auto index : member.indices) {
+                *indices++ = index + (uint32_t)member.vertexStart;
+            }
+        }
+        ibuf->unlock();
+        vbuf->unlock();
+
+        vertexData->vertexCount = vertexCount;
+        sub->indexData->indexStart = 0;
+        sub->indexData->indexCount = indexCount;
+
+        auto size = Ogre::Vector3(regionBlocks * TerrainDataBlock::getLevelBlockSize(region.lod));
+        region.mesh->_setBounds(Ogre::AxisAlignedBox(Ogre::Vector3(0), size));
+        region.mesh->_setBoundingSphereRadius(size.length());
+
+        if(created) {
+            region.mesh->load();
+            region.entity = sceneManager->createEntity(region.mesh);
+            region.entity->setMaterialName(materialName);
+            region.node = sceneManager->getRootSceneNode()->createChildSceneNode(OgreVecFromV3I(region.pos));
+            region.node->attachObject(region.entity);
+        }
+
+        region.needsRebuild = false;
+        region.needsPatch = false;
+        region.hasEdit = false;
+        stats.rebuilds++;
+        stats.uploadedVertices += vertexCount;
+    }
+
+    void TerrainRegionBatcher::patch(Region& region) {
+        auto vbuf = region.mesh->sharedVertexData->vertexBufferBinding->getBuffer(0);
+        auto& ibuf = region.mesh->getSubMesh(0)->indexData->indexBuffer;
+        for(auto& [pos, member] : region.members) {
+            if(!member.needsPatch) {
+                continue;
+            }
+            auto vertexSize = sizeof(TransvoxelPolygonizatorVertex);
+            vbuf->writeData(member.vertexStart * vertexSize, member.vertices.size() * vertexSize, member.vertices.data());
+
+            scratchIndices.clear();
+            for(auto index : member.indices) {
+                scratchIndices.push_back(index + (uint32_t)member.vertexStart);
+            }
+            ibuf->writeData(member.indexStart * sizeof(uint32_t), scratchIndices.size() * sizeof(uint32_t), scratchIndices.data());
+
+            member.needsPatch = false;
+            stats.patches++;
+            stats.uploadedVertices += member.vertices.size();
+        }
+        region.needsPatch = false;
+        region.hasEdit = false;
+    }
+
+    void TerrainRegionBatcher::destroy(Region& region) {
+        if(!region.mesh) {
+            return;
+        }
+        auto bind = region.mesh->sharedVertexData->vertexBufferBinding;
+        if(bind->isBufferBound(0)) {
+            pool->release(bind->getBuffer(0));
+        }
+        bind->unsetAllBindings();
+        pool->release(std::move(region.mesh->getSubMesh(0)->indexData->indexBuffer));
+
+        sceneManager->destroyEntity(region.entity);
+        sceneManager->destroySceneNode(region.node);
+        Ogre::MeshManager::getSingleton().remove(region.mesh);
+        region.mesh.reset();
+        region.entity = nullptr;
+        region.node = nullptr;
+    }
+
+    void TerrainRegionBatcher::cullOccluded(OcclusionCuller& culler) {
+        for(auto& [key, region] : regions) {
+            if(!culler.isEnabled() || !region.entity || !culler.isOccluderCandidate(getRegionBox(region))) {
+                continue;
+            }
+            auto pos = OgreVecFromV3I(region.pos);
+            for(auto& [memberKey, member] : region.members) {
+                for(auto& box : member.occluders) {
+                    culler.addOccluder(Ogre::AxisAlignedBox(pos + box.getMinimum(), pos + box.getMaximum()));
+                }
+            }
+        }
+        culler.rasterize();
+
+        //Occluders of a region lie inside its box, so a region never hides itself
+        stats.occludedRegions = 0;
+        for(auto& [key, region] : regions) {
+            if(!region.entity) {
+                continue;
+            }
+            bool visible = culler.isVisible(getRegionBox(region));
+            region.entity->setVisible(visible);
+            stats.occludedRegions += !visible;
+        }
+    }
+
+    TerrainRegionBatcher::Stats TerrainRegionBatcher::getStats() const {
+        auto result = stats;
+        result.regions = (int)regions.size();
+        result.members = 0;
+        for(auto& [key, region] : regions) {
+            result.members += (int)region.members.size();
+        }
+        return result;
+    }
+
+}
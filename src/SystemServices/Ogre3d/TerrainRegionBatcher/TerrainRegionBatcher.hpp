@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Ogre.h>
+#include <SystemServices/Ogre3d/ChunkBufferPool/ChunkBufferPool.hpp>
+#include <SystemServices/Ogre3d/OcclusionCuller/OcclusionCuller.hpp>
+#include <Terrain/TerrainMeshing/TerrainMeshing.hpp>
+
+namespace fluorite {
+
+    /**
+     * Merges meshes of terrain blocks of the same LoD into region batches, regionBlocks^3 blocks each, so the number of
+     * entities and draw calls grows with the number of regions instead of blocks. Changes are collected and applied in
+     * update(): a member that keeps its vertex and index count is patched in place, any other change rebuilds just its region.
+     * Rebuilding a region writes all its members, so update() is given a byte budget and leaves regions that don't fit for
+     * later frames, except regions changed by edits, which are always written on the next update. Region buffers are interleaved positions and normals, laid out as TransvoxelPolygonizatorVertex.
+     * Meant for the render thread only
+     */
+    class TerrainRegionBatcher {
+        public:
+            struct Stats {
+                int regions = 0;
+                //Block parts held, a block meshed in two parts counts twice
+                int members = 0;
+                int64_t rebuilds = 0;
+                int64_t patches = 0;
+                //Vertices written into region buffers by rebuilds and patches
+                int64_t uploadedVertices = 0;
+                //Vertex and index bytes written by rebuilds and patches
+                int64_t uploadedBytes = 0;
+                size_t lastFrameBytes = 0;
+                //Changed regions left for later frames by the last update
+                int deferredRegions = 0;
+                //Regions hidden by the last cullOccluded
+                int occludedRegions = 0;
+            };
+
+        private:
+            struct Member {
+                //Region local
+                std::vector<TransvoxelPolygonizatorVertex> vertices;
+                //Member local, offset by vertexStart when written
+                std::vector<int> indices;
+                //Region local, see TerrainOccluders
+                std::vector<Ogre::AxisAlignedBox> occluders;
+                //Where member lives in region buffers after the last rebuild
+                size_t vertexStart = 0;
+                size_t indexStart = 0;
+                bool needsPatch = false;
+            };
+
+            //Block position and part, interior and boundary of a block are separate members
+            using MemberKey = std::pair<Vec3Int, TransvoxelPolygonizator::BlockPart>;
+
+            struct Region {
+                Vec3Int pos;
+                int lod;
+                std::map<MemberKey, Member> members;
+                bool needsRebuild = false;
+                bool needsPatch = false;
+                //Pending changes include an edit, written regardless of the budget
+                bool hasEdit = false;
+                Ogre::MeshPtr mesh;
+                Ogre::Entity* entity = nullptr;
+                Ogre::SceneNode* node = nullptr;
+            };
+
+            Ogre::SceneManager* sceneManager;
+            ChunkBufferPool* pool;
+            std::string materialName;
+            int regionBlocks;
+            //(lod, region position)
+            std::map<std::pair<int, Vec3Int>, Region> regions;
+            //Reused by update() for ordering
+            std::vector<std::pair<float, std::map<std::pair<int, Vec3Int>, Region>::iterator>> order;
+            int meshCounter = 0;
+            std::vector<uint32_t> scratchIndices;
+            Stats stats;
+
+            Vec3Int getRegionPos(Vec3Int blockPos, int lod) const;
+            Ogre::AxisAlignedBox getRegionBox(const Region& region) const;
+            size_t getUploadBytes(const Region& region) const;
+            void stage(TerrainMeshResult& mesh);
+            void rebuild(Region& region);
+            void patch(Region& region);
+            void destroy(Region& region);
+
+        public:
+            /**
+             * @param pool source of region vertex and index buffers
+             * @param regionBlocks edge of a region in blocks
+             */
+            TerrainRegionBatcher(Ogre::SceneManager* sceneManager, ChunkBufferPool* pool, std::string materialName, int regionBlocks = 4);
+            ~TerrainRegionBatcher();
+
+            TerrainRegionBatcher(const TerrainRegionBatcher&) = delete;
+            TerrainRegionBatcher& operator=(const TerrainRegionBatcher&) = delete;
+
+            /**
+             * Adds mesh of a block part, or replaces mesh the part had. WHOLE mesh replaces interior and boundary
+             * of the block and the other way round. Empty mesh removes the part. Either vertex format is accepted,
+             * full format buffers are taken over instead of copied. Shown after the next update(), on the first one when
+             * the mesh is of an edit
+             *
+             * @return how much the bytes waiting for upload grew, a mesh that makes its region rebuild costs the whole region
+             */
+            size_t setMesh(TerrainMeshResult&& mesh, bool edit = false);
+
+            void removeMesh(Vec3Int blockPos, int lod, TransvoxelPolygonizator::BlockPart part);
+
+            /**
+             * Removes all parts of a block
+             */
+            void removeBlock(Vec3Int blockPos, int lod);
+
+            /**
+             * Uploads pending changes of edited regions, then of other regions nearest to viewer first, until byteBudget
+             * is spent. Edits count against the budget but are never left out. Other regions that would exceed it keep
+             * their changes for a later call. At least one region is uploaded every call, so changes drain
+             * even when a single region exceeds the budget. Call once per frame before rendering
+             *
+             * @return bytes written into region buffers
+             */
+            size_t update(Ogre::Vector3 viewer, size_t byteBudget);
+
+            /**
+             * Bytes the pending changes would write if all were uploaded now
+             */
+            size_t getPendingBytes() const;
+
+            /**
+             * Hides regions that are completely behind terrain. Occluders of regions near the camera are rasterized
+             * into culler, then every region is tested against them. Call after update(), once the culler has
+             * started the frame. Regions are shown again by the next call that finds them visible
+             */
+            void cullOccluded(OcclusionCuller& culler);
+
+            Stats getStats() const;
+    };
+
+}
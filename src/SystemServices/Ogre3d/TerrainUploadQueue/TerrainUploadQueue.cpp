@@ -0,0 +1,73 @@
+#include <SystemServices/Ogre3d/TerrainUploadQueue/TerrainUploadQueue.hpp>
+
+#include <chrono>
+
+namespace fluorite {
+
+    void TerrainUploadQueue::submit(TerrainMeshResult mesh, Priority priority) {
+        stats.submitted++;
+        auto key = Key({mesh.blockPos, mesh.lod, mesh.part});
+        auto waiting = pending.find(key);
+        if(waiting == pending.end()) {
+            pending.emplace(key, Entry({std::move(mesh), priority}));
+            return;
+        }
+
+        //Meshing finishes out of order, an older version must not overwrite a newer one
+        stats.dropped++;
+        waiting->second.priority = std::max(waiting->second.priority, priority);
+        if(mesh.version >= waiting->second.mesh.version) {
+            waiting->second.mesh = std::move(mesh);
+        }
+    }
+
+    void TerrainUploadQueue::cancel(Vec3Int blockPos, int lod) {
+        for(auto part : {TransvoxelPolygonizator::WHOLE, TransvoxelPolygonizator::INTERIOR, TransvoxelPolygonizator::BOUNDARY}) {
+            stats.dropped += pending.erase({blockPos, lod, part});
+        }
+    }
+
+    void TerrainUploadQueue::process(Ogre::Vector3 viewer, size_t downstreamBytes, const std::function<size_t(TerrainMeshResult&, Priority)>& upload) {
+        auto start = std::chrono::high_resolution_clock::now();
+        stats.lastFrameBytes = 0;
+        stats.lastFrameSeconds = 0;
+        if(pending.empty()) {
+            return;
+        }
+
+        auto uploadedBefore = stats.uploaded;
+
+        //Viewer moves between frames, so order is recomputed instead of kept in a heap
+        order.clear();
+        for(auto entry = pending.begin(); entry != pending.end(); entry++) {
+            auto extent = (float)TerrainDataBlock::getLevelBlockSize(entry->first.lod);
+            auto center = OgreVecFromV3I(entry->first.blockPos) + Ogre::Vector3(extent * 0.5f);
+            order.push_back({center.squaredDistance(viewer), entry});
+        }
+        std::sort(order.begin(), order.end(), [](auto& a, auto& b) {
+            return std::make_pair(-(int)a.second->second.priority, a.first) < std::make_pair(-(int)b.second->second.priority, b.first);
+        });
+
+        //Cost of a mesh is only known once the consumer has it, so the mesh that crosses the budget is the last one
+        for(auto& [distance, entry] : order) {
+            auto priority = entry->second.priority;
+            auto seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            bool spent = downstreamBytes + stats.lastFrameBytes >= budget.bytes || seconds > budget.seconds;
+            if(priority != EDIT && spent && (downstreamBytes > 0 || stats.uploaded > uploadedBefore)) {
+                break;
+            }
+
+            stats.lastFrameBytes += upload(entry->second.mesh, priority);
+            stats.uploaded++;
+            pending.erase(entry);
+        }
+        stats.lastFrameSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    TerrainUploadQueue::Stats TerrainUploadQueue::getStats() const {
+        auto result = stats;
+        result.pending = (int)pending.size();
+        return result;
+    }
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Terrain/TerrainMeshing/TerrainMeshing.hpp>
+#include <functional>
+
+namespace fluorite {
+
+    /**
+     * Staging area between finished CPU meshes and hardware buffers. Meshes wait here until a frame has budget left for
+     * them, so a burst of new blocks is uploaded over several frames instead of stalling one. Nearest blocks go first,
+     * a newer mesh of the same block replaces the waiting one, and meshes of evicted blocks are dropped unseen.
+     * Meshes are passed on while the consumer has less than the byte budget waiting to be written, the consumer itself
+     * keeps what it writes to hardware buffers per frame within the budget, see TerrainRegionBatcher::update.
+     * Meshes of edits skip the budget, so a change the player made is shown on the next frame however much is streaming
+     */
+    class TerrainUploadQueue {
+        public:
+            enum Priority {
+                //Within the frame budget, nearest first
+                STREAMED,
+                //Before streamed meshes and regardless of the budget
+                EDIT,
+            };
+
+            struct Budget {
+                //Vertex and index bytes written to hardware buffers per frame
+                size_t bytes = 4 * 1024 * 1024;
+                //Time spent in the upload callback per frame
+                double seconds = 0.004;
+            };
+
+            struct Stats {
+                int64_t submitted = 0;
+                int64_t uploaded = 0;
+                //Replaced by a newer mesh of the same block, or cancelled
+                int64_t dropped = 0;
+                int pending = 0;
+                //Bytes the meshes passed on by the last process added to what the consumer has to write
+                size_t lastFrameBytes = 0;
+                double lastFrameSeconds = 0;
+            };
+
+        private:
+            struct Key {
+                Vec3Int blockPos;
+                int lod;
+                TransvoxelPolygonizator::BlockPart part;
+
+                bool operator <(const Key& rhs) const {
+                    return std::make_tuple(blockPos, lod, part) < std::make_tuple(rhs.blockPos, rhs.lod, rhs.part);
+                }
+            };
+
+            struct Entry {
+                TerrainMeshResult mesh;
+                Priority priority;
+            };
+
+            std::map<Key, Entry> pending;
+            //Reused by process() for ordering
+            std::vector<std::pair<float, std::map<Key, Entry>::iterator>> order;
+            Budget budget;
+            Stats stats;
+
+        public:
+            void setBudget(Budget newBudget) {
+                budget = newBudget;
+            }
+
+            Budget getBudget() const {
+                return budget;
+            }
+
+            /**
+             * Queues mesh for upload. Mesh built from an older block version than the one already waiting is ignored.
+             * A block waiting with EDIT priority keeps it when replaced, since the newer mesh includes the edit
+             */
+            void submit(TerrainMeshResult mesh, Priority priority = STREAMED);
+
+            /**
+             * Drops waiting meshes of a block, all parts
+             */
+            void cancel(Vec3Int blockPos, int lod);
+
+            /**
+             * Passes all waiting edits to upload, then other meshes nearest to viewer first, until the frame budget is spent.
+             * When nothing waits downstream, at least one mesh is passed, so the queue drains even when single meshes
+             * exceed the budget
+             *
+             * @param downstreamBytes bytes the consumer still has to write from earlier frames, they count against the budget
+             * @param upload returns how many bytes the mesh added to what the consumer has to write. Mesh is dropped
+             * from the queue afterwards, so upload may take its buffers
+             */
+            void process(Ogre::Vector3 viewer, size_t downstreamBytes, const std::function<size_t(TerrainMeshResult&, Priority)>& upload);
+
+            Stats getStats() const;
+    };
+
+}
@@ -0,0 +1,87 @@
+#include <Terrain/CellClassifier/CellClassifier.hpp>
+
+#include <bit>
+#include <type_traits>
+#include <misc/Simd.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * Sign bits of Width consecutive densities, bit x is set when density x is negative
+     */
+    template<int Width>
+    static inline uint32_t rowSigns(const int8_t* row) {
+#ifdef FLUORITE_SSE2
+        uint32_t mask = 0;
+        for(int x = 0; x < Width; x += 16) {
+            mask |= (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(row + x))) << x;
+        }
+        return mask;
+#else
+        uint32_t mask = 0;
+        for(int x = 0; x < Width; x++) {
+            mask |= (uint32_t)((uint8_t)row[x] >> 7) << x;
+        }
+        return mask;
+#endif
+    }
+
+    template<int BlockSize>
+    void CellClassifier::classify(const int8_t* origin, int rowStride, int sliceStride, std::vector<uint32_t>& activeCells) {
+        static_assert(BlockSize % 16 == 0 && BlockSize <= 32);
+        using RowMask = std::conditional_t<BlockSize <= 16, uint16_t, uint32_t>;
+        const uint32_t cellsMask = (uint32_t)((1ull << BlockSize) - 1);
+
+        activeCells.clear();
+
+        //Signs of corners with x = 0..BlockSize-1 and of corners shifted by one voxel, x = 1..BlockSize, for every row
+        RowMask lo[BlockSize + 1][BlockSize + 1];
+        RowMask hi[BlockSize + 1][BlockSize + 1];
+        for(int z = 0; z <= BlockSize; z++) {
+            for(int y = 0; y <= BlockSize; y++) {
+                auto row = origin + z * sliceStride + y * rowStride;
+                lo[z][y] = rowSigns<BlockSize>(row);
+                hi[z][y] = rowSigns<BlockSize>(row + 1);
+            }
+        }
+
+        //Each bit of these masks is one cell of a row, so the whole row is tested at once
+        for(int z = 0; z < BlockSize; z++) {
+            for(int y = 0; y < BlockSize; y++) {
+                uint32_t m0 = lo[z][y];
+                uint32_t m1 = hi[z][y];
+                uint32_t m2 = lo[z + 1][y];
+                uint32_t m3 = hi[z + 1][y];
+                uint32_t m4 = lo[z][y + 1];
+                uint32_t m5 = hi[z][y + 1];
+                uint32_t m6 = lo[z + 1][y + 1];
+                uint32_t m7 = hi[z + 1][y + 1];
+
+                uint32_t any = m0 | m1 | m2 | m3 | m4 | m5 | m6 | m7;
+                uint32_t all = m0 & m1 & m2 & m3 & m4 & m5 & m6 & m7;
+                uint32_t active = any & ~all & cellsMask;
+
+                while(active) {
+                    int x = std::countr_zero(active);
+                    active &= active - 1;
+
+                    uint8_t caseCode = ((m0 >> x) & 1)
+                        | (((m1 >> x) & 1) << 1)
+                        | (((m2 >> x) & 1) << 2)
+                        | (((m3 >> x) & 1) << 3)
+                        | (((m4 >> x) & 1) << 4)
+                        | (((m5 >> x) & 1) << 5)
+                        | (((m6 >> x) & 1) << 6)
+                        | (((m7 >> x) & 1) << 7);
+
+                    activeCells.push_back(pack(x, y, z, caseCode));
+                }
+            }
+        }
+    }
+
+    template void CellClassifier::classify<16>(const int8_t*, int, int, std::vector<uint32_t>&);
+    template void CellClassifier::classify<32>(const int8_t*, int, int, std::vector<uint32_t>&);
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace fluorite
+{
+
+    /**
+     * Finds cells of a block that are crossed by the isosurface. Sign bits of whole rows of densities are
+     * extracted at once and combined across neighbouring rows and slices with bitwise operations, so trivial cells
+     * (all corners on the same side) cost next to nothing. Only non-trivial cells are reported, with their case codes.
+     *
+     * Case code bit i is the sign of corner i, where corner i is at (i & 1, (i >> 2) & 1, (i >> 1) & 1),
+     * same as TransvoxelPolygonizator::getCornerByIndex
+     */
+    class CellClassifier {
+        public:
+            static uint32_t pack(int x, int y, int z, uint8_t caseCode) {
+                return (uint32_t)x | ((uint32_t)y << 8) | ((uint32_t)z << 16) | ((uint32_t)caseCode << 24);
+            }
+            static int getX(uint32_t cell) {return cell & 0xFF;}
+            static int getY(uint32_t cell) {return (cell >> 8) & 0xFF;}
+            static int getZ(uint32_t cell) {return (cell >> 16) & 0xFF;}
+            static uint8_t getCaseCode(uint32_t cell) {return cell >> 24;}
+
+            /**
+             * Instantiated for block sizes 16 and 32, a row of cells must fit into 32 bit mask
+             *
+             * @param origin density of voxel (0,0,0). Voxels up to BlockSize on every axis are read
+             * @param rowStride distance between voxels neighbouring along y
+             * @param sliceStride distance between voxels neighbouring along z
+             * @param activeCells receives packed cells, ordered by z, then y, then x. Cleared first, capacity is reused
+             */
+            template<int BlockSize>
+            static void classify(const int8_t* origin, int rowStride, int sliceStride, std::vector<uint32_t>& activeCells);
+    };
+
+}
@@ -0,0 +1,50 @@
+#include <Terrain/GradientField/GradientField.hpp>
+
+#include <misc/Simd.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * out[x] = a[x] - b[x] for x in 0..Width, widened to 16 bits
+     */
+    template<int Width>
+    static inline void rowDifference(const int8_t* a, const int8_t* b, int16_t* out) {
+#ifdef FLUORITE_SSE2
+        for(int x = 0; x < Width; x += 16) {
+            auto va = _mm_loadu_si128((const __m128i*)(a + x));
+            auto vb = _mm_loadu_si128((const __m128i*)(b + x));
+            //Sign extension: byte goes to the high half of a 16 bit lane, then is shifted back down
+            auto aLo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+            auto aHi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+            auto bLo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+            auto bHi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+            _mm_storeu_si128((__m128i*)(out + x), _mm_sub_epi16(aLo, bLo));
+            _mm_storeu_si128((__m128i*)(out + x + 8), _mm_sub_epi16(aHi, bHi));
+        }
+        out[Width] = (int16_t)a[Width] - b[Width];
+#else
+        for(int x = 0; x <= Width; x++) {
+            out[x] = (int16_t)a[x] - b[x];
+        }
+#endif
+    }
+
+    template<int BlockSize>
+    void GradientField<BlockSize>::compute(const int8_t* origin, int rowStride, int sliceStride, int zFirst, int zLast) {
+        static_assert(BlockSize % 16 == 0);
+        for(int z = zFirst; z <= zLast; z++) {
+            for(int y = 0; y < size; y++) {
+                const int8_t* row = origin + z * sliceStride + y * rowStride;
+                auto index = getIndex(0, y, z);
+                rowDifference<BlockSize>(row + 1, row - 1, &m_x[index]);
+                rowDifference<BlockSize>(row + rowStride, row - rowStride, &m_y[index]);
+                rowDifference<BlockSize>(row + sliceStride, row - sliceStride, &m_z[index]);
+            }
+        }
+    }
+
+    template class GradientField<16>;
+    template class GradientField<32>;
+
+}
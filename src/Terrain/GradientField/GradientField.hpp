@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Ogre.h>
+#include <cstdint>
+#include <vector>
+
+namespace fluorite
+{
+
+    /**
+     * Density gradients of every cell corner of a block. Each voxel is a corner of up to 8 cells, so gradients
+     * are computed once per block with a SIMD sweep over whole rows, and cells only look them up.
+     * Components are stored unscaled (difference of neighbouring densities) in separate arrays, buffers are reused.
+     * Instantiated for block sizes 16 and 32
+     */
+    template<int BlockSize>
+    class GradientField {
+        public:
+            //Corners run from 0 to BlockSize inclusive
+            static constexpr int size = BlockSize + 1;
+
+        private:
+            std::vector<int16_t> m_x;
+            std::vector<int16_t> m_y;
+            std::vector<int16_t> m_z;
+
+            static int getIndex(int x, int y, int z) {return x + size * (y + size * z);}
+
+        public:
+            GradientField() : m_x(size * size * size), m_y(size * size * size), m_z(size * size * size) {}
+
+            /**
+             * @param origin density of voxel (0,0,0). Voxels from -1 to size on every axis are read, so apron must be at least 2
+             * @param rowStride distance between voxels neighbouring along y
+             * @param sliceStride distance between voxels neighbouring along z
+             * @param zFirst,zLast range of corner slices to compute, others keep stale values
+             */
+            void compute(const int8_t* origin, int rowStride, int sliceStride, int zFirst = 0, int zLast = size - 1);
+
+            /**
+             * Unit normal at corner, pointing towards increasing density. Zero where the gradient is zero
+             */
+            Ogre::Vector3 getNormal(int x, int y, int z) const {
+                auto index = getIndex(x, y, z);
+                return (Ogre::Vector3(m_x[index], m_y[index], m_z[index]) * 0.5f).normalisedCopy();
+            }
+    };
+
+}
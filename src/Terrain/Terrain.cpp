@@ -1,6 +1,7 @@
 #include <Terrain/Terrain.hpp>
 
 #include <iostream>
+#include <cstring>
 
 namespace fluorite
 {
@@ -25,7 +26,7 @@ namespace fluorite
     TerrainChunkFinder::TerrainChunkFinder(TerrainBlocksStorageInterface* provider) : m_storage(provider) {}
 
     int TerrainChunk::chunkSize = 16;
-    std::vector<Vec3Int> TerrainChunk::neghboursShifts = {{1,0,0}, {0,1,0}, {1,1,0}, {0,0,1}, {0,1,1}, {1,0,1}, {1,1,1} };
+    std::vector<Vec3Int> TerrainChunk::neghboursShifts = {{-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
     int TerrainChunk::getLevelChunkSize(int level) {  return chunkSize * (1 << (level - 1)); }
     Vec3Int TerrainChunk::gridAlign(Vec3Int pos, int level) {  return pos.align(TerrainChunk::getLevelChunkSize(level)); }
     TerrainChunk::TerrainChunk(Vec3Int pos, int lod) : m_pos(pos), m_lod(lod) {}
@@ -44,6 +45,16 @@ namespace fluorite
     void TerrainChunk::initRenderables(){
         std::for_each(m_renderables.begin(), m_renderables.end(), [this](auto& renderable){renderable->init(this);});
     };
+    void TerrainChunk::updateRenderables(){
+        std::for_each(m_renderables.begin(), m_renderables.end(), [this](auto& renderable){renderable->update(this);});
+    };
+    void TerrainChunk::setNeghbouringLods(std::vector<int> lods) {
+        if(lods == m_neghbourLod) {
+            return;
+        }
+        m_neghbourLod = lods;
+        std::for_each(m_renderables.begin(), m_renderables.end(), [this](auto& renderable){renderable->updateSeams(this);});
+    }
     
     Vec3Int TerrainChunk::getPos() {
         return m_pos;
@@ -81,13 +92,13 @@ namespace fluorite
                         if(prevRadius == 0 || newBlock.isBetween(prevLoBorder, prevHiBorder)) {
                             auto requestedBlock = m_storage->requestBlock(newBlock, currLevel);
                            
-                           //Calculating neghbouringLods
+                           //Calculating neghbouringLods, from the ring containing a voxel just behind the middle of each face
                             auto neghbourLods = std::vector<int>();
                             for(auto neghbour : TerrainChunk::neghboursShifts) {
-                                auto neghbourPos = neghbour * currBlockSize;
-                                if(neghbourPos.isBetween(prevLoBorder, prevHiBorder)) {
-                                    neghbourLods.push_back(prevRadius == 0 ? 1 : (currLevel - 1));
-                                } else if(neghbourPos.isBetween(loBorder, hiBorder)) {
+                                auto neghbourPos = newBlock.add(Vec3Int(currBlockSize / 2)).add(neghbour.mul(Vec3Int(currBlockSize / 2 + 1)));
+                                if(prevRadius != 0 && !neghbourPos.isBetween(prevLoBorder, prevHiBorder)) {
+                                    neghbourLods.push_back(currLevel - 1);
+                                } else if(!neghbourPos.isBetween(loBorder, hiBorder)) {
                                     neghbourLods.push_back(currLevel);
                                 } else {
                                     neghbourLods.push_back(currLevel + 1);
@@ -177,7 +188,194 @@ namespace fluorite
     }
 
 
+    void TerrainDataBlockStorage::fillBlock(TerrainDataBlock* block) {
+        auto blockPos = block->getPos();
+        auto size = TerrainDataBlock::getBlockSize();
+        auto step = block->getStep();
+        auto contents = block->beginWrite();
+
+        //Interior of a downsampled block is already filled, the generator only has to cover the apron
+        bool downsampled = block->getLevel() > 1 && downsample(block, contents.get());
+
+        if(m_generator) {
+            for(int z = -m_apron; z < size + m_apron; z++) {
+                for(int y = -m_apron; y < size + m_apron; y++) {
+                    bool interiorRow = downsampled && z >= 0 && z < size && y >= 0 && y < size;
+                    for(int x = -m_apron; x < size + m_apron; x++) {
+                        if(interiorRow && x == 0) {
+                            x = size - 1;
+                            continue;
+                        }
+                        auto local = Vec3Int(x, y, z);
+                        contents->setNode(local, m_generator(blockPos + local * step));
+                    }
+                }
+            }
+        }
+
+        pullApron(block, contents.get());
+
+        block->commit(std::move(contents));
+    }
+
+    bool TerrainDataBlockStorage::downsample(TerrainDataBlock* block, TerrainDataBlockSnapshot* contents) {
+        auto size = TerrainDataBlock::getBlockSize();
+        auto level = block->getLevel();
+        auto childSize = TerrainDataBlock::getLevelBlockSize(level - 1);
+
+        std::shared_ptr<const TerrainDataBlockSnapshot> children[8];
+        for(int i = 0; i < 8; i++) {
+            auto child = getBlockIfExists(block->getPos() + Vec3Int(i & 1, (i >> 1) & 1, (i >> 2) & 1) * childSize, level - 1);
+            if(!child) {
+                return false;
+            }
+            children[i] = child->snapshot();
+        }
+
+        //Filters read one voxel around the sample, which lies in the apron of the child
+        auto filter = m_apron > 0 ? m_mipFilter : POINT;
+        auto half = size / 2;
+
+        for(int z = 0; z < size; z++) {
+            for(int y = 0; y < size; y++) {
+                for(int x = 0; x < size; x++) {
+                    auto childIndex = (x / half) | ((y / half) << 1) | ((z / half) << 2);
+                    auto& child = children[childIndex];
+                    auto fine = Vec3Int((x % half) * 2, (y % half) * 2, (z % half) * 2);
+
+                    auto node = child->getNode(fine);
+                    if(filter == AVERAGE) {
+                        int sum = 0;
+                        for(int dz = -1; dz <= 1; dz++) {
+                            for(int dy = -1; dy <= 1; dy++) {
+                                for(int dx = -1; dx <= 1; dx++) {
+                                    auto weight = (2 - std::abs(dx)) * (2 - std::abs(dy)) * (2 - std::abs(dz));
+                                    sum += child->getNode(fine + Vec3Int(dx, dy, dz)).val * weight;
+                                }
+                            }
+                        }
+                        node.val = sum / 64;
+                    } else if(filter == MIN) {
+                        for(int dz = -1; dz <= 1; dz++) {
+                            for(int dy = -1; dy <= 1; dy++) {
+                                for(int dx = -1; dx <= 1; dx++) {
+                                    node.val = std::min(node.val, child->getNode(fine + Vec3Int(dx, dy, dz)).val);
+                                }
+                            }
+                        }
+                    }
+                    contents->setNode(Vec3Int(x, y, z), node);
+                }
+            }
+        }
+        return true;
+    }
+
+    void TerrainDataBlockStorage::pullApron(TerrainDataBlock* block, TerrainDataBlockSnapshot* contents,
+        const std::map<Vec3Int, std::shared_ptr<TerrainDataBlockSnapshot>>* pending) {
+        if(m_apron == 0) {
+            return;
+        }
+
+        auto blockPos = block->getPos();
+        auto level = block->getLevel();
+        auto size = TerrainDataBlock::getBlockSize();
+        auto worldSize = TerrainDataBlock::getLevelBlockSize(level);
+
+        for(int dx = -1; dx <= 1; dx++) {
+            for(int dy = -1; dy <= 1; dy++) {
+                for(int dz = -1; dz <= 1; dz++) {
+                    if(dx == 0 && dy == 0 && dz == 0) {continue;}
+                    auto direction = Vec3Int(dx, dy, dz);
+                    auto neighbourPos = blockPos + direction * worldSize;
+                    std::shared_ptr<const TerrainDataBlockSnapshot> neighbourContents;
+                    if(pending && pending->count(neighbourPos)) {
+                        neighbourContents = pending->at(neighbourPos);
+                    } else {
+                        auto neighbour = getBlockIfExists(neighbourPos, level);
+                        if(!neighbour) {continue;}
+                        neighbourContents = neighbour->snapshot();
+                    }
+                    //Part of neighbour's interior that falls into our apron, in our local coordinates
+                    auto lo = Vec3Int(dx < 0 ? -m_apron : (dx == 0 ? 0 : size), dy < 0 ? -m_apron : (dy == 0 ? 0 : size), dz < 0 ? -m_apron : (dz == 0 ? 0 : size));
+                    auto hi = Vec3Int(dx < 0 ? 0 : (dx == 0 ? size : size + m_apron), dy < 0 ? 0 : (dy == 0 ? size : size + m_apron), dz < 0 ? 0 : (dz == 0 ? size : size + m_apron));
+                    auto shift = direction * size;
+                    for(int z = lo.z; z < hi.z; z++) {
+                        for(int y = lo.y; y < hi.y; y++) {
+                            for(int x = lo.x; x < hi.x; x++) {
+                                auto local = Vec3Int(x, y, z);
+                                contents->setNode(local, neighbourContents->getNode(local - shift));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void TerrainDataBlockStorage::refreshCoarseLevels(Vec3Int lo, Vec3Int hi) {
+        for(int level = 2; level <= m_maxLevel; level++) {
+            auto worldSize = TerrainDataBlock::getLevelBlockSize(level);
+            auto step = 1 << (level - 1);
+            //Filter of the coarse voxel reaches one finer voxel around it, and aprons reach further
+            auto reach = step * (m_apron + 1);
+            auto levelLo = lo.substract(reach);
+            auto levelHi = hi.add(reach);
+
+            //Each block is written once, so readers never see an updated interior with a stale apron
+            std::map<Vec3Int, std::shared_ptr<TerrainDataBlockSnapshot>> pending;
+            std::vector<std::shared_ptr<TerrainDataBlock>> affected;
+            auto first = levelLo.align(worldSize);
+            for(int x = first.x; x <= levelHi.x; x += worldSize) {
+                for(int y = first.y; y <= levelHi.y; y += worldSize) {
+                    for(int z = first.z; z <= levelHi.z; z += worldSize) {
+                        auto block = getBlockIfExists(Vec3Int(x, y, z), level);
+                        if(block) {
+                            affected.push_back(block);
+                        }
+                    }
+                }
+            }
+
+            //Interiors first, so aprons are pulled from already updated neighbours
+            for(auto& block : affected) {
+                auto contents = block->beginWrite();
+                downsample(block.get(), contents.get());
+                pending.emplace(block->getPos(), std::move(contents));
+            }
+            for(auto& block : affected) {
+                pullApron(block.get(), pending[block->getPos()].get(), &pending);
+            }
+            for(auto& block : affected) {
+                block->commit(std::move(pending[block->getPos()]));
+            }
+        }
+    }
+
+    static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+        //Word at a time multiply-xorshift mixing. Not cryptographic, but every input bit affects the result
+        const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+        auto bytes = static_cast<const uint8_t*>(data);
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * multiplier;
+            hash ^= hash >> 29;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, bytes + i, size - i);
+        hash = (hash ^ tail ^ size) * multiplier;
+        return hash ^ (hash >> 32);
+    }
+
+    uint64_t TerrainDataBlockSnapshot::computeContentHash() const {
+        auto hash = hashBytes(m_stride, m_density.data(), m_density.size());
+        return hashBytes(hash, m_material.data(), m_material.size() * sizeof(uint16_t));
+    }
+
     int TerrainDataBlock::blockSize = 16;
+    std::atomic<int> TerrainDataBlockSnapshot::liveSnapshots = 0;
 
 }
 
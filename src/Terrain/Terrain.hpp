@@ -8,7 +8,12 @@
 #include <algorithm>
 #include <functional>
 #include <limits>
+#include <atomic>
+#include <cmath>
+#include <cassert>
 #include <Terrain/TransvoxelTables/TransvoxelTables.h>
+#include <Terrain/CellClassifier/CellClassifier.hpp>
+#include <Terrain/GradientField/GradientField.hpp>
 #include <Ogre.h>
 #include <iostream>
 #include <string>
@@ -237,6 +242,15 @@ namespace fluorite
         public:
         virtual std::string getName() {return "UNKNOWN";}
         virtual void init(TerrainChunk*) = 0;
+        /**
+         * Called when terrain data under the chunk was modified. By default renderable is just rebuilt from scratch
+         */
+        virtual void update(TerrainChunk* chunk) { init(chunk); }
+        /**
+         * Called when LoD of a face neighbour changed. Renderables meshing interior and boundary separately
+         * (see TransvoxelPolygonizator::BlockPart) only need to rebuild the boundary
+         */
+        virtual void updateSeams(TerrainChunk* chunk) { update(chunk); }
         virtual ~TerrainChunkRenderableInterface(){};
     };
 
@@ -244,6 +258,7 @@ namespace fluorite
         public:
             static int chunkSize;
             static int getLevelChunkSize(int level);
+            //Face neighbours: -x, +x, -y, +y, -z, +z
             static std::vector<Vec3Int> neghboursShifts;
         private:
             Vec3Int m_pos;
@@ -256,9 +271,10 @@ namespace fluorite
             static Vec3Int gridAlign(Vec3Int pos, int level);
             TerrainChunk(Vec3Int pos, int lod);
 
-            void setNeghbouringLods(std::vector<int> lods) {
-                m_neghbourLod = lods;
-            }
+            /**
+             * LoDs of face neighbours, ordered as neghboursShifts. Renderables are notified when they change
+             */
+            void setNeghbouringLods(std::vector<int> lods);
 
             std::vector<int> getNeighbouringLods() {
                 return m_neghbourLod;
@@ -271,6 +287,7 @@ namespace fluorite
             void resetFramesSinceLastUse();
             void incrementFramesSiceLastUse();
             void initRenderables();
+            void updateRenderables();
 
     };
 
@@ -353,68 +370,417 @@ namespace fluorite
     };
 
 
+    /**
+     * Immutable version of a data block contents. Readers pin a snapshot by holding a shared_ptr to it,
+     * so it stays valid no matter how many new versions are published meanwhile.
+     * Snapshot is freed when the last reader or the block itself drops it
+     */
+    class TerrainDataBlockSnapshot {
+        private:
+            static std::atomic<int> liveSnapshots;
+
+            int m_size;
+            //Number of voxels copied from neighbouring blocks on every side
+            int m_apron;
+            int m_stride;
+            uint64_t m_version;
+            //Densities and materials are kept in separate arrays, so rows of densities can be processed with SIMD
+            std::vector<int8_t> m_density;
+            std::vector<uint16_t> m_material;
+
+        public:
+            TerrainDataBlockSnapshot(int size, int apron, uint64_t version) : m_size(size), m_apron(apron), m_stride(size + 2 * apron), m_version(version),
+                m_density(m_stride*m_stride*m_stride), m_material(m_stride*m_stride*m_stride) {liveSnapshots++;}
+            TerrainDataBlockSnapshot(const TerrainDataBlockSnapshot& other) : m_size(other.m_size), m_apron(other.m_apron), m_stride(other.m_stride), m_version(other.m_version),
+                m_density(other.m_density), m_material(other.m_material) {liveSnapshots++;}
+            TerrainDataBlockSnapshot& operator=(const TerrainDataBlockSnapshot&) = delete;
+            ~TerrainDataBlockSnapshot() {liveSnapshots--;}
+
+            /**
+             * Position is local to the block and may lie in the apron, from -apron to size + apron - 1
+             */
+            int getNodeIndex(Vec3Int pos) const {
+                return (pos.x + m_apron) + m_stride * (pos.y + m_apron) + m_stride*m_stride * (pos.z + m_apron);
+            }
+
+            TerrainDataBlockNode getNode(Vec3Int pos) const {
+                auto index = getNodeIndex(pos);
+                auto node = TerrainDataBlockNode(m_density[index]);
+                node.mat = m_material[index];
+                return node;
+            }
+            void setNode(Vec3Int pos, TerrainDataBlockNode node) {
+                auto index = getNodeIndex(pos);
+                m_density[index] = node.val;
+                m_material[index] = node.mat;
+            }
+
+            int8_t getDensity(Vec3Int pos) const {return m_density[getNodeIndex(pos)];}
+
+            /**
+             * Raw densities, including the apron. Voxel at local position p is at getNodeIndex(p)
+             */
+            const int8_t* getDensityData() const {return m_density.data();}
+
+            bool contains(Vec3Int pos) const {
+                return pos.x >= -m_apron && pos.y >= -m_apron && pos.z >= -m_apron
+                    && pos.x < m_size + m_apron && pos.y < m_size + m_apron && pos.z < m_size + m_apron;
+            }
+
+            int getSize() const {return m_size;}
+            int getApron() const {return m_apron;}
+            int getStride() const {return m_stride;}
+            uint64_t getVersion() const {return m_version;}
+
+            /**
+             * 64-bit hash of densities and materials, including the apron. Equal contents give equal hashes
+             * regardless of block position or version. Reads every voxel, so callers should keep the result
+             */
+            uint64_t computeContentHash() const;
+            void setVersion(uint64_t version) {m_version = version;}
+
+            /**
+             * Number of snapshots currently alive across all blocks. Useful to check that old versions are reclaimed
+             */
+            static int getLiveCount() {return liveSnapshots;}
+    };
+
+    /**
+     * Data block with copy-on-write contents. Any number of threads may read it through snapshot() without locking.
+     * Modifications are made on a private copy obtained from beginWrite() and published with commit(), so writer
+     * never waits for readers. Blocks are expected to have a single writer(gameplay thread)
+     */
     class TerrainDataBlock : public FrameCounter {
         private:
             static int blockSize;
 
-            std::vector<TerrainDataBlockNode> m_vec;
+            std::atomic<std::shared_ptr<const TerrainDataBlockSnapshot>> m_current;
             Vec3Int m_pos;
+            int m_apron;
+            //Level of detail. Voxels of level n are 2^(n-1) world voxels apart
+            int m_level;
 
-            int getNodeIndex(Vec3Int pos) {
-                return pos.x + blockSize * pos.y + blockSize*blockSize * pos.z;
-            }
-            int getNodeIndex(int x, int y, int z) {
-                return x + blockSize * y + blockSize*blockSize * z;
-            }
+            //Set while block was created by prefetching and nobody requested it yet
+            bool m_prefetched = false;
+
+            //Range of cells(inclusive, in local coordinates) that must be remeshed since last clearDirty()
+            bool m_isDirty = false;
+            Vec3Int m_dirtyLo;
+            Vec3Int m_dirtyHi;
 
         public:
+            /**
+             * Cells reach one voxel past the block and corner normals sample one more, so this is the least apron
+             * the polygonizer, CellClassifier and GradientField can work with
+             */
+            static const int defaultApron = 2;
+
             void reset() {
-                m_vec.clear();
-                m_vec.resize(blockSize*blockSize*blockSize);
+                auto version = m_current.load() ? m_current.load()->getVersion() + 1 : 0;
+                m_current.store(std::make_shared<const TerrainDataBlockSnapshot>(blockSize, m_apron, version));
             }
 
-            TerrainDataBlock(Vec3Int pos) : m_pos(pos) {reset();}
+            /**
+             * @param apron number of voxels from neighbouring blocks stored around the block. Polygonization requires at least 2
+             */
+            TerrainDataBlock(Vec3Int pos, int apron = defaultApron, int level = 1) : m_pos(pos), m_apron(apron), m_level(level) {reset();}
 
-            TerrainDataBlockNode& getNode(Vec3Int pos) {return m_vec[getNodeIndex(pos)];}
+            /**
+             * Pins current version of block contents
+             */
+            std::shared_ptr<const TerrainDataBlockSnapshot> snapshot() const {
+                return m_current.load();
+            }
+
+            TerrainDataBlockNode getNode(Vec3Int pos) const {return m_current.load()->getNode(pos);}
+
+            /**
+             * Returns a private copy of current contents. Changes become visible only after commit()
+             */
+            std::shared_ptr<TerrainDataBlockSnapshot> beginWrite() const {
+                return std::make_shared<TerrainDataBlockSnapshot>(*m_current.load());
+            }
+
+            /**
+             * Publishes new version of contents. Readers that pinned previous version keep it until they release it
+             */
+            void commit(std::shared_ptr<TerrainDataBlockSnapshot> contents) {
+                contents->setVersion(m_current.load()->getVersion() + 1);
+                m_current.store(std::move(contents));
+            }
+
+            /**
+             * Convenience for single-voxel changes. Every call copies the whole block, so batch changes with beginWrite() instead
+             */
+            void setNode(Vec3Int pos, TerrainDataBlockNode node) {
+                auto contents = beginWrite();
+                contents->setNode(pos, node);
+                commit(std::move(contents));
+            }
+
+            uint64_t getVersion() const {
+                return m_current.load()->getVersion();
+            }
 
             Vec3Int getPos() {
                 return m_pos;
             }
 
+            static int getBlockSize() {
+                return blockSize;
+            }
+
+            /**
+             * Polygonizer is compiled for 16 and 32 only. Must be called before any block is created
+             * @return false if size is not supported
+             */
+            static bool setBlockSize(int size) {
+                if(size != 16 && size != 32) {
+                    return false;
+                }
+                blockSize = size;
+                return true;
+            }
+
+            /**
+             * Size of the block in world voxels for a given level
+             */
+            static int getLevelBlockSize(int level) {
+                return blockSize << (level - 1);
+            }
+
+            int getApron() {
+                return m_apron;
+            }
+
+            int getLevel() {
+                return m_level;
+            }
+
+            /**
+             * Distance between neighbouring voxels of this block in world voxels
+             */
+            int getStep() {
+                return 1 << (m_level - 1);
+            }
+
+            bool isPrefetched() {
+                return m_prefetched;
+            }
+            void setPrefetched(bool prefetched) {
+                m_prefetched = prefetched;
+            }
+
+            /**
+             * Extends dirty range of this block. Both lo and hi are inclusive local cell coordinates
+             * and are clipped to the block
+             */
+            void markDirty(Vec3Int lo, Vec3Int hi) {
+                for(int i = 0; i < 3; i++) {
+                    lo[i] = std::clamp(lo[i], 0, blockSize - 1);
+                    hi[i] = std::clamp(hi[i], 0, blockSize - 1);
+                }
+                if(!m_isDirty) {
+                    m_dirtyLo = lo;
+                    m_dirtyHi = hi;
+                    m_isDirty = true;
+                    return;
+                }
+                for(int i = 0; i < 3; i++) {
+                    m_dirtyLo[i] = std::min(m_dirtyLo[i], lo[i]);
+                    m_dirtyHi[i] = std::max(m_dirtyHi[i], hi[i]);
+                }
+            }
+
+            bool isDirty() {
+                return m_isDirty;
+            }
+            Vec3Int getDirtyLo() {
+                return m_dirtyLo;
+            }
+            Vec3Int getDirtyHi() {
+                return m_dirtyHi;
+            }
+            void clearDirty() {
+                m_isDirty = false;
+            }
+
     };
 
 
 
 
+    typedef std::function<TerrainDataBlockNode(Vec3Int)> TerrainDensityFunction;
+
     class TerrainDataBlockStorage {
+        public:
+            /**
+             * Hit is a request for a block that was already prefetched, miss is a request that had to generate it.
+             * Wasted are prefetched blocks that were removed without ever being requested
+             */
+            struct PrefetchStats {
+                int prefetched = 0;
+                int hits = 0;
+                int misses = 0;
+                int wasted = 0;
+
+                float hitRate() const {
+                    return hits + misses > 0 ? (float)hits / (hits + misses) : 0.0f;
+                }
+            };
+
+            /**
+             * How coarse levels are produced from finer ones. Transition cells expect coarse samples to equal fine
+             * ones at shared positions, so seams between LoDs only close exactly with POINT
+             */
+            enum MipFilter {
+                //Takes every second voxel, same as sampling the finer level directly
+                POINT,
+                //1-2-1 tent filter, removes aliasing of thin features. Leaves cracks along LoD seams
+                AVERAGE,
+                //Smallest density around the voxel. Keeps thin gaps and caves open. Leaves cracks along LoD seams
+                MIN,
+            };
+
         private:
-            std::map<Vec3Int, std::shared_ptr<TerrainDataBlock>> m_storage;
+            struct StorageKey {
+                Vec3Int m_pos;
+                int level;
+                bool operator <(const StorageKey& rhs) const  {
+                    return std::make_tuple(level, m_pos.x, m_pos.y, m_pos.z) < std::make_tuple(rhs.level, rhs.m_pos.x, rhs.m_pos.y, rhs.m_pos.z);
+                }
+            };
+
+            std::map<StorageKey, std::shared_ptr<TerrainDataBlock>> m_storage;
             EventDelegate<std::shared_ptr<TerrainDataBlock>> m_onBlockCreated;
             int m_removeBlocksAfterFrames = 10;
+            int m_apron;
+            int m_maxLevel = 1;
+            MipFilter m_mipFilter = POINT;
+            TerrainDensityFunction m_generator;
+            PrefetchStats m_prefetchStats;
+
+            std::shared_ptr<TerrainDataBlock> createBlock(Vec3Int pos, int level) {
+                auto newBlock = std::make_shared<TerrainDataBlock>(pos, m_apron, level);
+                fillBlock(newBlock.get());
+                m_storage.insert({{pos, level}, newBlock});
+                m_maxLevel = std::max(m_maxLevel, level);
+                m_onBlockCreated.call(newBlock);
+                return newBlock;
+            }
+
+            /**
+             * Generates contents of a new block, including the apron. Coarse blocks are downsampled from finer level when
+             * it is available. Parts of the apron that are covered by already existing neighbours are copied from them,
+             * since they could have been edited
+             */
+            void fillBlock(TerrainDataBlock* block);
+
+            /**
+             * Replaces interior of a coarse block with filtered voxels of its 8 children.
+             * @return false if some of the children doesn't exist
+             */
+            bool downsample(TerrainDataBlock* block, TerrainDataBlockSnapshot* contents);
+
+            /**
+             * Copies interiors of existing neighbours into the apron of contents.
+             * @param pending uncommitted contents of neighbours on the same level, used instead of their published snapshots
+             */
+            void pullApron(TerrainDataBlock* block, TerrainDataBlockSnapshot* contents,
+                const std::map<Vec3Int, std::shared_ptr<TerrainDataBlockSnapshot>>* pending = nullptr);
 
         public:
+            static const int defaultApron = TerrainDataBlock::defaultApron;
+
+            /**
+             * Flat ground at y = 0
+             */
+            static TerrainDataBlockNode defaultDensity(Vec3Int worldPos) {
+                return TerrainDataBlockNode(std::clamp(-worldPos.y * 4, -127, 127));
+            }
+
+            TerrainDataBlockStorage(TerrainDensityFunction generator = defaultDensity, int apron = defaultApron) : m_apron(apron), m_generator(generator) {}
 
             void onBlockCreated(std::function<void(std::shared_ptr<TerrainDataBlock>)> block) {
                 m_onBlockCreated.add(block);
             }
-            
-            std::shared_ptr<TerrainDataBlock> requestBlock(Vec3Int pos) {
-                auto block = m_storage.find(pos);
+
+            int getApron() {
+                return m_apron;
+            }
+
+            void setMipFilter(MipFilter filter) {
+                m_mipFilter = filter;
+            }
+
+            /**
+             * @param level level of detail. Blocks of level n cover TerrainDataBlock::getLevelBlockSize(n) world voxels
+             */
+            std::shared_ptr<TerrainDataBlock> requestBlock(Vec3Int pos, int level = 1) {
+                auto block = m_storage.find({pos, level});
                 if(block != m_storage.end()) {
                     block->second->resetFramesSinceLastRequest();
+                    if(block->second->isPrefetched()) {
+                        block->second->setPrefetched(false);
+                        m_prefetchStats.hits++;
+                    }
                     return block->second;
                 }
 
-                auto newBlock = std::make_shared<TerrainDataBlock>(pos);
-                m_storage.insert({pos, newBlock});
-                m_onBlockCreated.call(newBlock);
+                m_prefetchStats.misses++;
+                return createBlock(pos, level);
+            }
+
+            /**
+             * Creates block ahead of time without counting it as requested. Existing blocks are just kept alive
+             */
+            std::shared_ptr<TerrainDataBlock> prefetchBlock(Vec3Int pos, int level = 1) {
+                auto block = m_storage.find({pos, level});
+                if(block != m_storage.end()) {
+                    block->second->resetFramesSinceLastRequest();
+                    return block->second;
+                }
+
+                m_prefetchStats.prefetched++;
+                auto newBlock = createBlock(pos, level);
+                newBlock->setPrefetched(true);
                 return newBlock;
             }
+
+            /**
+             * Prevents existing block from being removed, without creating it or counting it as requested
+             */
+            void keepAlive(Vec3Int pos, int level = 1) {
+                auto block = m_storage.find({pos, level});
+                if(block != m_storage.end()) {
+                    block->second->resetFramesSinceLastRequest();
+                }
+            }
+
+            PrefetchStats getPrefetchStats() {
+                return m_prefetchStats;
+            }
+
+            std::shared_ptr<TerrainDataBlock> getBlockIfExists(Vec3Int pos, int level = 1) {
+                auto block = m_storage.find({pos, level});
+                if(block != m_storage.end()) {
+                    return block->second;
+                }
+                return nullptr;
+            }
+
+            /**
+             * Rebuilds existing coarse blocks after voxels of level 1 were changed in a given world range(inclusive)
+             */
+            void refreshCoarseLevels(Vec3Int lo, Vec3Int hi);
             
             void removeOldBlocks() {
                  for (auto it = m_storage.begin(); it != m_storage.end();) {
                     it->second->incrementFrameSinceLastRequestCounter();
                     if (it->second->getFramesSinceLastRequest() > m_removeBlocksAfterFrames)  {
+                        if(it->second->isPrefetched()) {
+                            m_prefetchStats.wasted++;
+                        }
                         m_storage.erase(it++);
                     } else {
                         ++it;
@@ -440,22 +806,45 @@ namespace fluorite
 
 struct ReuseCell
 {
-    std::vector<int> verts;
+    int verts[12];
     uint16_t caseIndex;
-    ReuseCell(int size = 4) {
-        verts.resize(size);
-        for (int i = 0; i < size; i++) {
-            verts[i] = -1;
-        }
+    ReuseCell() {
+        reset();
+    }
+    void reset() {
+        std::fill(std::begin(verts), std::end(verts), -1);
+        caseIndex = 0;
     }
 };
 
+/**
+ * Indices of vertices that can be reused by following cells. Only current and previous z slices are kept,
+ * each cell owns up to 4 reusable vertices. Every slot remembers which cell wrote it, so passes visiting only
+ * a part of the block never pick up a stale index from a cell they skipped
+ */
+template<int BlockSize>
 class RegularCellCache
 {
     private:
-        ReuseCell _cache[2][16 * 16];
+        static constexpr int sliceCells = BlockSize * BlockSize;
+
+        int _cache[2][sliceCells][4];
+        int _owner[2][sliceCells];
+
+        static constexpr int getCellKey(int x, int y, int z) {
+            return x + BlockSize * (y + BlockSize * z);
+        }
+
     public:
-        ReuseCell GetReusedIndex(Vec3Int pos, uint8_t rDir)
+        RegularCellCache() {
+            reset();
+        }
+
+        void reset() {
+            std::fill(&_owner[0][0], &_owner[0][0] + 2 * sliceCells, -1);
+        }
+
+        int GetReusedIndex(Vec3Int pos, uint8_t rDir, uint8_t reuseIndex) const
         {
             int rx = rDir & 0x01;
             int rz = (rDir >> 1) & 0x01;
@@ -465,65 +854,146 @@ class RegularCellCache
             int dy = pos.y - ry;
             int dz = pos.z - rz;
 
-            return _cache[dx & 1][dy * 16 + dz];
+            if(_owner[dz & 1][dy * BlockSize + dx] != getCellKey(dx, dy, dz)) {
+                return -1;
+            }
+            return _cache[dz & 1][dy * BlockSize + dx][reuseIndex];
         }
 
         void SetReusableIndex(Vec3Int pos, uint8_t reuseIndex, int p) {
-            _cache[pos.x & 1][pos.y * 16 + pos.z].verts[reuseIndex] = p;
+            _owner[pos.z & 1][pos.y * BlockSize + pos.x] = getCellKey(pos.x, pos.y, pos.z);
+            _cache[pos.z & 1][pos.y * BlockSize + pos.x][reuseIndex] = p;
         }
     };
 
+/**
+ * Transition cells of current and previous row along one face, BlockSize / 2 per row
+ */
+template<int BlockSize>
 class TransitionCache
 {
     private:
-        ReuseCell _cache[2 * 17 * 17];
+        static constexpr int rowCells = BlockSize / 2;
 
-    public:
-        TransitionCache() {
-        const int cacheSize =  2 * 17 * 17;
+        ReuseCell _cache[2 * rowCells];
 
-        for (int i = 0; i < cacheSize; i++)
-        {
-            _cache[i] = ReuseCell(12);
+    public:
+    void reset() {
+        for (auto& cell : _cache) {
+            cell.reset();
         }
     }
 
     ReuseCell& getCell(int x, int y) {
-        return _cache[x + (y & 1) * 17]; 
+        return _cache[x + (y & 1) * rowCells]; 
     }
 
     void setCell(int x, int y, ReuseCell val) {
-        _cache[x + (y & 1) * 16] = val;
+        _cache[x + (y & 1) * rowCells] = val;
     }
 };
 
 
 
-    struct Vertex
-    {
-        Ogre::Vector3 Primary;
-        Ogre::Vector3 Secondary;
-        Ogre::Vector3 Normal;
-        uint8_t Near;
-    };
-
-
-
     struct TransvoxelPolygonizatorVertex {
         Ogre::Vector3 pos;
         Ogre::Vector3 normal;
         TransvoxelPolygonizatorVertex(Ogre::Vector3 _pos, Ogre::Vector3 _normal) : pos(_pos), normal(_normal) {}
     };
 
+    /**
+     * Compact vertex, 12 bytes instead of 24. Position is block local, in cells of the mesh LoD as 8.8 fixed point,
+     * which is exact for regular cells since edges are interpolated in 1/256 steps. Renderer scales it back
+     * with getPositionScale(). Normal is stored as signed bytes, so fixed function pipeline can read it directly
+     */
+    struct TransvoxelPackedVertex {
+        //w is always 1
+        int16_t pos[4];
+        //w is unused
+        int8_t normal[4];
+
+        static float getPositionScale(int lod) {
+            return (1 << (lod - 1)) / 256.0f;
+        }
+
+        static TransvoxelPackedVertex pack(Ogre::Vector3 position, Ogre::Vector3 normal, int lod) {
+            auto result = TransvoxelPackedVertex();
+            auto p = position / getPositionScale(lod);
+            auto n = normal.normalisedCopy() * 127.0f;
+            for(int i = 0; i < 3; i++) {
+                result.pos[i] = (int16_t)std::lround(p[i]);
+                result.normal[i] = (int8_t)std::lround(n[i]);
+            }
+            result.pos[3] = 1;
+            result.normal[3] = 0;
+            return result;
+        }
+
+        Ogre::Vector3 getPosition(int lod) const {
+            return Ogre::Vector3(pos[0], pos[1], pos[2]) * getPositionScale(lod);
+        }
+
+        Ogre::Vector3 getNormal() const {
+            return Ogre::Vector3(normal[0], normal[1], normal[2]) / 127.0f;
+        }
+    };
+    static_assert(sizeof(TransvoxelPackedVertex) == 12);
+
 
     class TransvoxelPolygonizator {
 
+        public:
+            enum VertexFormat {
+                //TransvoxelPolygonizatorVertex and 32 bit indices
+                FULL,
+                //TransvoxelPackedVertex and 16 bit indices
+                PACKED,
+            };
+
+            /**
+             * Block can be meshed in two parts. Interior cells never depend on neighbours, while boundary cells and
+             * transition cells change with neighbour LoDs. So when only a neighbour LoD changes, just the boundary is rebuilt
+             */
+            enum BlockPart {
+                WHOLE,
+                //Cells not touching any face of the block
+                INTERIOR,
+                //Cells touching a face, and transition cells
+                BOUNDARY,
+            };
+
         private:
-            
-            static Ogre::Vector3 generateVertexPos(Vec3Int offsetPos, Vec3Int pos, int lod, long t, uint8_t v0, uint8_t v1)
+            /**
+             * Per block caches, sized at compile time for one block size
+             */
+            template<int BlockSize>
+            struct BlockSizeState {
+                RegularCellCache<BlockSize> cache;
+                TransitionCache<BlockSize> transitionCache;
+                GradientField<BlockSize> gradients;
+            };
+
+            static int getLodScale(int lod) {
+                return 1 << (lod - 1);
+            }
+
+            /**
+             * Distance between voxels of the LoD being polygonized. Specialized steps fold to a constant,
+             * step 0 stands for LoDs without a specialization and is read at runtime
+             */
+            template<int LodStep>
+            int getScale() const {
+                if constexpr (LodStep > 0) {
+                    return LodStep;
+                } else {
+                    return getLodScale(currentLod);
+                }
+            }
+
+            static Ogre::Vector3 generateVertexPos(Vec3Int offsetPos, int scale, long t, uint8_t v0, uint8_t v1)
             {
-                auto p0 = OgreVecFromV3I(offsetPos.add(getCornerByIndex(v0)).mul(lod));
-                auto p1 = OgreVecFromV3I(offsetPos.add(getCornerByIndex(v1)).mul(lod));
+                auto p0 = OgreVecFromV3I(offsetPos.add(getCornerByIndex(v0)).mul(scale));
+                auto p1 = OgreVecFromV3I(offsetPos.add(getCornerByIndex(v1)).mul(scale));
                 return interpolateVoxelVector(t, p0, p1);
             }
 
@@ -537,7 +1007,7 @@ class TransitionCache
             }
 
             static Vec3Int getCornerByIndex(int index) {
-                return Vec3Int(index & 0x01, (index >> 2) && 0x01, (index >> 1) & 0x01);
+                return Vec3Int(index & 0x01, (index >> 2) & 0x01, (index >> 1) & 0x01);
             }
 
             static uint8_t HiNibble(uint8_t b)
@@ -551,134 +1021,59 @@ class TransitionCache
             }
 
 
-            float S = 1.0f / 256.0f;
+            /**
+             * Fraction of a cell taken by transition cells. Regular cells next to a face with a coarser neighbour
+             * are squeezed by this much to make room for them
+             */
+            static constexpr float transitionWidth = 0.5f;
 
-            Ogre::Vector3 Interp(Vec3Int v0, Vec3Int v1, Vec3Int p0, Vec3Int p1, uint8_t lodIndex = 0)
-            {
-                return Interp(OgreVecFromV3I(v0), OgreVecFromV3I(v1), p0, p1, lodIndex);
-            }
-
-            Ogre::Vector3 Interp(Ogre::Vector3 v0, Ogre::Vector3 v1, Vec3Int p0, Vec3Int p1, uint8_t lodIndex = 0)
-            {
-                auto s0 = getNode(p0).val;
-                auto s1 = getNode(p1).val;
+            //Faces are ordered -x, +x, -y, +y, -z, +z, same as TerrainChunk::neghboursShifts
+            static int getFaceAxis(int face) {return face >> 1;}
+            static bool isPositiveFace(int face) {return (face & 1) != 0;}
 
-                int t = (s1 << 8) / (s1 - s0);
-                int u = 0x0100 - t;
+            /**
+             * Moves vertex lying in a boundary cell away from faces with transition cells. The offset is projected
+             * onto the tangent plane, so the surface keeps its shape. Vertices with the same position and normal
+             * always end up at the same place, which keeps regular and transition cells connected
+             */
+            template<int BlockSize>
+            Ogre::Vector3 getSecondaryPosition(Ogre::Vector3 position, Ogre::Vector3 normal, float scale) const {
+                auto cellPos = position / scale;
+                const float last = BlockSize - 1;
 
-                if ((t & 0x00ff) == 0)
-                {
-                    // The generated vertex lies at one of the corners so there 
-                    // is no need to subdivide the interval.
-                    if (t == 0)
-                    {
-                        return v1;
+                auto delta = Ogre::Vector3::ZERO;
+                for(int axis = 0; axis < 3; axis++) {
+                    if((transitionMask & (1 << (axis * 2))) && cellPos[axis] < 1.0f) {
+                        delta[axis] = (1.0f - cellPos[axis]) * transitionWidth;
                     }
-                    return v0;
-                }
-                else
-                {
-                    for (int i = 0; i < lodIndex; ++i)
-                    {
-                        Ogre::Vector3 vm = (v0 + v1) / 2;
-                        Vec3Int pm = (p0 + p1) / 2;
-
-                        auto sm = getNode(pm).val;
-
-                        // Determine which of the sub-intervals that contain 
-                        // the intersection with the isosurface.
-                        if (sgn(s0) != sgn(sm))
-                        {
-                            v1 = vm;
-                            p1 = pm;
-                            s1 = sm;
-                        }
-                        else
-                        {
-                            v0 = vm;
-                            p0 = pm;
-                            s0 = sm;
-                        }
+                    if((transitionMask & (1 << (axis * 2 + 1))) && cellPos[axis] > last) {
+                        delta[axis] = (last - cellPos[axis]) * transitionWidth;
                     }
-                    t = (s1 << 8) / (s1 - s0);
-                    u = 0x0100 - t;
-
-                    return v0 * t * S + v1 * u * S;
-                }
-            }
-
-            static Ogre::Vector3 ComputeDelta(Ogre::Vector3 v, int k, int s)
-            {
-                float p2k = k * k; // 1 << k would do the job much more efficient
-                float wk = std::pow(2, k - 2);
-                auto delta = Ogre::Vector3::ZERO;
-
-                if (k < 1)
-                {
-                    return delta;
                 }
-
-                // x
-                float p = v.x;
-                float p2mk = std::pow(2.0, -k);
-                if (p < p2k)
-                {
-                    // The vertex is inside the minimum cell.
-                    delta.x = (1.0f - p2mk * p) * wk;
-                }
-                else if (p > (p2k * (s - 1)))
-                {
-                    // The vertex is inside the maximum cell.
-                    delta.x = ((p2k * s) - 1.0f - p) * wk;
+                if(delta == Ogre::Vector3::ZERO) {
+                    return position;
                 }
 
-                // y
-                p = v.y;
-                if (p < p2k)
-                {
-                    // The vertex is inside the minimum cell.
-                    delta.y = (1.0f - p2mk * p) * wk;
-                }
-                else if (p > (p2k * (s - 1)))
-                {
-                    // The vertex is inside the maximum cell.
-                    delta.y = ((p2k * s) - 1.0f - p) * wk;
-                }
-
-                // z
-                p = v.z;
-                if (p < p2k)
-                {
-                    // The vertex is inside the minimum cell.
-                    delta.z = (1.0f - p2mk * p) * wk;
-                }
-                else if (p > (p2k * (s - 1)))
-                {
-                    // The vertex is inside the maximum cell.
-                    delta.z = ((p2k * s) - 1.0f - p) * wk;
-                }
-
-                return delta;
-            }
-
-            static Ogre::Vector3 ProjectNormal(Ogre::Vector3 n, Ogre::Vector3 delta)
-            {
-                return n.crossProduct(delta);
+                auto n = normal.normalisedCopy();
+                delta -= n * n.dotProduct(delta);
+                return position + delta * scale;
             }
 
             Vec3Int pos;
-
-            TerrainDataBlockNode getNode(Vec3Int shift) {
-                auto specPos = pos.add(shift);
-                float val = 0;// + sin(specPos.x * 0.3) * 4 + -sin(specPos.z * 0.07) * 12;
-                return TerrainDataBlockNode(std::clamp((int)(val - specPos.y ) * 4, -127, 127));
-                /*if(specPos.y < 9) {
-                    return TerrainDataBlockNode(127);
-                }
-                return TerrainDataBlockNode(-127);*/
+            //Contents of the block being polygonized. Pinned for the whole pass, so edits made meanwhile don't affect it
+            std::shared_ptr<const TerrainDataBlockSnapshot> data;
+
+            /**
+             * Position is local to the block. Everything within the apron is available, so no neighbours are ever needed
+             */
+            TerrainDataBlockNode getNode(Vec3Int local) {
+                return data->getNode(local);
             }
             
-            uint8_t getCaseCode(std::vector<TerrainDataBlockNode> corners) {
+            /**
+             * Scalar case code of a single cell. Whole blocks are classified with CellClassifier instead
+             */
+            static uint8_t getCaseCode(const TerrainDataBlockNode (&corners)[8]) {
                 uint8_t caseCode = 
                     ((corners[0].val >> 7) & 0x01)
                     | ((corners[1].val >> 6) & 0x02)
@@ -693,362 +1088,134 @@ class TransitionCache
             }
 
         
-            int PolygonizeTransitionCell(Vec3Int offset, Vec3Int origin, int lodIndex, int axis)
-            {
-                int lodStep = 1 << lodIndex;
-                int sampleStep = 1 << (lodIndex - 1);
-                int lodScale = 1 << lodIndex;
-                int last = 16 * lodScale;
-
-            uint8_t directionMask = 2;
-
-
-                /**
-                unsigned char nearq = 0;
-
-                // Compute which of the six faces of the block that the vertex 
-                // is near. (near is defined as being in boundary cell.)
-                for (int i = 0; i < 3; i++)
-                {
-                    // Vertex close to negative face.
-                    if (origin[i] == 0) { nearq |= (1 << (i * 2 + 0)); }
-                    // Vertex close to positive face.
-                    if (origin[i] == last) { nearq |= (1 << (i * 2 + 1)); }
-                }
-                Doesnt make any sence to calculate this. We are allways at the maximal face of the block
-                Calling this method for any other places is prohibited
-                */
-
-                /**
-                 * 
-                 * 
-                 *                  <>--------<>
-                 *                 /|         /|
-                 *                / |        / |
-                 *               /  |       /  |
-                 *              <>---<>---<>   |
-                 *              |   | |   |    |
-                 *              |   <>----|---<>
-                 *              <>---<>---<>  /
-                 *     z        | /   |   |  /
-                 *    /|\       |/    |   | /
-                 *     | _      <>---<>---<>
-                 *     | /|z
-                 *     |/____\ x
-                 *           /
-                 *    
-                 *
-                 *  This is a 9-4 block template where low-z values are more detailed and high-z values are less detailed
-                 */
-            Vec3Int coords[] = {
-                    Vec3Int(0,0,0), Vec3Int(1,0,0), Vec3Int(2,0,0), // High-res lower row
-                    Vec3Int(0,1,0), Vec3Int(1,1,0), Vec3Int(2,1,0), // High-res middle row
-                    Vec3Int(0,2,0), Vec3Int(1,2,0), Vec3Int(2,2,0), // High-res upper row
-                    Vec3Int(0,0,2), Vec3Int(2,0,2), // Low-res lower row
-                    Vec3Int(0,2,2), Vec3Int(2,2,2)  // Low-res upper row
-                };
-
-            auto mx = Vec3Float( 1,  0, -1) * sampleStep;
-            auto my = Vec3Float( 0,  1,  0) * sampleStep;
-            auto mz = Vec3Float( 1,  0,  1) * sampleStep;
-
-            auto basis = Matrix3X3().rotate({0,1,0},  Ogre::Math::DegreesToRadians(90));
-
-            std::vector<Vec3Int> pos;
-            for(int i = 0; i < 13; i++) {
-                auto currVec = (basis * coords[i]);
-                currVec.x = std::round(currVec.x);
-                currVec.y = std::round(currVec.y);
-                currVec.z = std::round(currVec.z);
-                pos.push_back(offset + currVec);
-            }
-
-            auto basis2 = Matrix3X3().rotate({0,1,0},  Ogre::Math::DegreesToRadians(0));
-
-                std::vector<Vec3Int> pos2;
-                for(int i = 0; i < 13; i++) {
-                    pos2.push_back(offset + (basis2 * coords[i]));
-                }
-
-
-            auto normals = std::vector<Ogre::Vector3>(13);
-
-            for (int i = 0; i < 9; i++)
-            {
-                auto p = pos[i];
-                float nx = (getNode(origin + p + Vec3Int::unitX()).val - getNode(origin + p - Vec3Int::unitX()).val) * 0.5f;
-                float ny = (getNode(origin + p + Vec3Int::unitY()).val - getNode(origin + p - Vec3Int::unitY()).val) * 0.5f;
-                float nz = (getNode(origin + p + Vec3Int::unitZ()).val - getNode(origin + p - Vec3Int::unitZ()).val) * 0.5f;
-                normals[i] = Ogre::Vector3(nx, ny, nz).normalisedCopy();
-            }
-
-            normals[0x9] = normals[0];
-            normals[0xA] = normals[2];
-            normals[0xB] = normals[6];
-            normals[0xC] = normals[8];
-
-                Vec3Int samplePos[] = {
-                    pos[0], pos[1], pos[2], 
-                    pos[3], pos[4], pos[5], 
-                    pos[6], pos[7], pos[8],
-                    pos[0], pos[2],
-                    pos[6], pos[8]
-                };
-
-                uint32_t caseCode = (sgnp(getNode(origin + pos[0]).val) * 0x001 |
-                                     sgnp(getNode(origin + pos[1]).val) * 0x002 |
-                                     sgnp(getNode(origin + pos[2]).val) * 0x004 |
-                                     sgnp(getNode(origin + pos[5]).val) * 0x008 |
-                                     sgnp(getNode(origin + pos[8]).val) * 0x010 |
-                                     sgnp(getNode(origin + pos[7]).val) * 0x020 |
-                                     sgnp(getNode(origin + pos[6]).val) * 0x040 |
-                                     sgnp(getNode(origin + pos[3]).val) * 0x080 |
-                                     sgnp(getNode(origin + pos[4]).val) * 0x100);
-
-                if (caseCode == 0 || caseCode == 511)
-                    return 0;
-
-                tcahe.getCell(offset.x, offset.y).caseIndex = caseCode;
-
-                auto classIndex = transitionCellClass[caseCode]; // Equivalence class index.
-                auto data = transitionCellData[classIndex & 0x7F];
-                bool inverse = (classIndex & 128) != 0;
-                std::vector<int> localVertexMapping(12);
-
-                int nv = (int)data.GetVertexCount();
-                int nt = (int)data.GetTriangleCount();
-
-                auto vert = Vertex();
-
-                for (int i = 0; i < nv; i++)
-                {
-                    auto edgeCode = transitionVertexData[caseCode][i];
-                    
-                    auto v0 = (edgeCode >> 4) & 0x0F; //First Corner Index
-                    auto v1 = (edgeCode) & 0x0F; //Second Corner Index
-
-                    bool lowside = (v0 > 8) && (v1 > 8);
-
-                    int d0 = getNode(samplePos[v0]).val;
-                    int d1 = getNode(samplePos[v1]).val;
-
-
-                    int t = (d1 << 8) / (d1 - d0);
-                    int u = 0x0100 - t;
-                    float t0 = t * S;
-                    float t1 = u * S;
-
-                    Ogre::Vector3 n0 = normals[v0];
-                    Ogre::Vector3 n1 = normals[v1];
-
-                    //vert.Near = nearq;
-                    vert.Normal = n0 * t0 + n1 * t1;
-
-
-                    if ((t & 0x00ff) != 0)
-                    {
-                        // Use the reuse information in transitionVertexData
-                        auto dir = HiNibble(edgeCode >> 8);
-                        auto idx = LoNibble(edgeCode >> 8);
-
-                        bool present = (dir & directionMask) == dir;
-
-                        if (present)
-                        {
-                            // The previous cell is available. Retrieve the cached cell 
-                            // from which to retrieve the reused vertex index from.
-                            auto prev = tcahe.getCell(offset.x - (dir & 1), offset.y - ((dir >> 1) & 1));
-
-                            if (prev.caseIndex == 0 || prev.caseIndex == 511)
-                            {
-                                // Previous cell does not contain any geometry.
-                                localVertexMapping[i] = -1;
-                            }
-                            else
-                            {
-                                // Reuse the vertex index from the previous cell.
-                                localVertexMapping[i] = prev.verts[idx];
-                            }
+            /**
+             * Transition cells along one face. Each of them covers 2x2 boundary cells: 9 samples of this block form
+             * its full resolution side, and 4 of them, which are also samples of the coarser neighbour, the half
+             * resolution side. Half resolution side lies on the face itself and matches the neighbour mesh exactly,
+             * full resolution side is moved inside together with boundary regular cells(see getSecondaryPosition).
+             * Transvoxel tables expect the same samples on both sides, so the neighbour must be point sampled
+             * from this block's data
+             */
+            template<int BlockSize, int LodStep>
+            void polygonizeTransitionFace(BlockSizeState<BlockSize>& state, int face) {
+                const int size = BlockSize;
+                auto scale = getScale<LodStep>();
+                auto& tcahe = state.transitionCache;
+                auto axis = getFaceAxis(face);
+                auto boundary = isPositiveFace(face) ? size : 0;
+                //(u, v, outward normal) is right handed on every face, so one winding rule works for all of them
+                auto uAxis = isPositiveFace(face) ? (axis + 1) % 3 : (axis + 2) % 3;
+                auto vAxis = isPositiveFace(face) ? (axis + 2) % 3 : (axis + 1) % 3;
+
+                tcahe.reset();
+
+                for (int j = 0; j < size / 2; j++) {
+                    for (int i = 0; i < size / 2; i++) {
+                        Vec3Int samples[13];
+                        for (int k = 0; k < 9; k++) {
+                            samples[k][axis] = boundary;
+                            samples[k][uAxis] = i * 2 + k % 3;
+                            samples[k][vAxis] = j * 2 + k / 3;
+                        }
+                        samples[0x9] = samples[0];
+                        samples[0xA] = samples[2];
+                        samples[0xB] = samples[6];
+                        samples[0xC] = samples[8];
+
+                        auto inside = [&](int k) { return data->getDensity(samples[k]) < 0 ? 1 : 0; };
+                        uint16_t caseCode = inside(0) * 0x001
+                            | inside(1) * 0x002
+                            | inside(2) * 0x004
+                            | inside(5) * 0x008
+                            | inside(8) * 0x010
+                            | inside(7) * 0x020
+                            | inside(6) * 0x040
+                            | inside(3) * 0x080
+                            | inside(4) * 0x100;
+
+                        auto& cell = tcahe.getCell(i, j);
+                        cell.caseIndex = caseCode;
+                        if (caseCode == 0 || caseCode == 511) {
+                            continue;
                         }
-                        if (!present || localVertexMapping[i] < 0)
-                        {
-                            
-                            auto p0 = OgreVecFromV3I(pos[v0]);
-                            auto p1 = OgreVecFromV3I(pos[v1]);
-
-                            auto pi = Interp(p0, p1, samplePos[v0], samplePos[v1], lowside ? lodIndex : (lodIndex - 1));
-
-                            auto vecPos = Ogre::Vector3();
-                            if (lowside)
-                            {
-                                switch (axis)
-                                {
-                                    case 0:
-                                        pi.x = (float)origin.x;
-                                        break;
-                                    case 1:
-                                        pi.y = (float)origin.y;
-                                        break;
-                                    case 2:
-                                        pi.z = (float)origin.z;
-                                        break;
-                                }
-
-                                Ogre::Vector3 delta = ComputeDelta(pi, lodIndex, 16);
-                                auto proj = ProjectNormal(vert.Normal, delta);
 
-                                //vert.Primary = Unused;
-                                vert.Secondary = pi;// + proj;
-                                vecPos = vert.Secondary;
-                            }
-                            else
-                            {
-                                vert.Near = 0;
-                                vert.Primary = pi;
-                                vecPos = vert.Primary;
+                        uint8_t directionMask = (i > 0 ? 1 : 0) | ((j > 0 ? 1 : 0) << 1);
+                        auto classIndex = transitionCellClass[caseCode];
+                        auto cellData = transitionCellData[classIndex & 0x7F];
+                        bool inverse = (classIndex & 0x80) != 0;
+                        int localVertexMapping[12];
+
+                        for (int k = 0; k < cellData.GetVertexCount(); k++) {
+                            auto edgeCode = transitionVertexData[caseCode][k];
+                            auto v0 = HiNibble(edgeCode & 0xFF);
+                            auto v1 = LoNibble(edgeCode & 0xFF);
+                            auto dir = HiNibble(edgeCode >> 8);
+                            auto idx = LoNibble(edgeCode >> 8);
+                            bool lowSide = v0 > 8 && v1 > 8;
+
+                            int index = -1;
+                            if ((dir & directionMask) == dir) {
+                                auto& prev = tcahe.getCell(i - (dir & 1), j - ((dir >> 1) & 1));
+                                if (prev.caseIndex != 0 && prev.caseIndex != 511) {
+                                    index = prev.verts[idx];
+                                }
                             }
 
-                            localVertexMapping[i] = vertices.size();
-                            vertices.push_back(TransvoxelPolygonizatorVertex(vecPos, Ogre::Vector3::UNIT_X));
+                            if (index < 0) {
+                                //Endpoints are ordered by position, so vertices shared with regular cells are interpolated the same way
+                                auto p0 = samples[v0];
+                                auto p1 = samples[v1];
+                                if (p1 < p0) {
+                                    std::swap(p0, p1);
+                                }
+                                int d0 = data->getDensity(p0);
+                                int d1 = data->getDensity(p1);
+                                int t = (d1 << 8) / (d1 - d0);
+
+                                auto normal = state.gradients.getNormal(p0.x, p0.y, p0.z) * (t / 256.0f) + state.gradients.getNormal(p1.x, p1.y, p1.z) * ((0x100 - t) / 256.0f);
+                                auto vertex = interpolateVoxelVector(t, OgreVecFromV3I(p0.mul(scale)), OgreVecFromV3I(p1.mul(scale)));
+                                if (!lowSide) {
+                                    vertex = getSecondaryPosition<BlockSize>(vertex, normal, scale);
+                                }
+                                index = addVertex(vertex, normal);
 
-                            if ((dir & 8) != 0)
-                            {
-                                // The vertex can be reused.
-                                tcahe.getCell(offset.x, offset.y).verts[idx] = localVertexMapping[i];
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // Try to reuse corner vertex from a preceding cell.
-                        // Use the reuse information in transitionCornerData.
-                        auto v = t == 0 ? v1 : v0;
-                        auto cornerData = transitionCornerData[v];
-
-                        auto dir = HiNibble(cornerData); // High nibble contains direction code.
-                        auto idx = LoNibble((cornerData)); // Low nibble contains storage slot for vertex.
-                        bool present = (dir & directionMask) == dir;
-
-                        if (present)
-                        {
-                            // The previous cell is available. Retrieve the cached cell 
-                            // from which to retrieve the reused vertex index from.
-                            auto prev = tcahe.getCell(offset.x - (dir & 1), offset.y - ((dir >> 1) & 1));
-
-                            if (prev.caseIndex == 0 || prev.caseIndex == 511)
-                            {
-                                // Previous cell does not contain any geometry.
-                                localVertexMapping[i] = -1;
-                            }
-                            else
-                            {
-                                // Reuse the vertex index from the previous cell.
-                                localVertexMapping[i] = prev.verts[idx];
+                                if ((dir & 8) != 0) {
+                                    cell.verts[idx] = index;
+                                }
                             }
+                            localVertexMapping[k] = index;
                         }
 
-                        Ogre::Vector3 vecPos;
-                        if (!present || localVertexMapping[i] < 0)
-                        {
-                            // A vertex has to be created.
-                            auto pi = OgreVecFromV3I(pos[v]);
-
-                            if (v > 8)
-                            {
-                                // On low-resolution side.
-                                // Necessary to translate the intersection point to the 
-                                // high-res side so that it is transformed the same way 
-                                // as the vertices in the regular cell.
-                                switch (axis)
-                                {
-                                    case 0:
-                                        pi.x = (float)origin.x;
-                                        break;
-                                    case 1:
-                                        pi.y = (float)origin.y;
-                                        break;
-                                    case 2:
-                                        pi.z = (float)origin.z;
-                                        break;
-                                }
-
-                                auto delta = ComputeDelta(pi, lodIndex, 16);
-                                auto proj = ProjectNormal(vert.Normal, delta);
-
-                                vert.Secondary = pi + proj;
-                                vecPos = vert.Secondary;
-                            }
-                            else
-                            {
-                                // On high-resolution side.
-                                vert.Near = 0; // Vertices on high-res side are never moved.
-                                vert.Primary = pi;
-                                vecPos = vert.Primary;
+                        for (int t = 0; t < cellData.GetTriangleCount(); t++) {
+                            auto triangle = &cellData.vertexIndex[t * 3];
+                            if (inverse) {
+                                addIndex(localVertexMapping[triangle[0]]);
+                                addIndex(localVertexMapping[triangle[1]]);
+                                addIndex(localVertexMapping[triangle[2]]);
+                            } else {
+                                addIndex(localVertexMapping[triangle[2]]);
+                                addIndex(localVertexMapping[triangle[1]]);
+                                addIndex(localVertexMapping[triangle[0]]);
                             }
-                            std::cout << vecPos.x;
-                            localVertexMapping[i] = vertices.size();
-                            tcahe.getCell(offset.x, offset.y).verts[idx] = localVertexMapping[i];
-                            vertices.push_back(TransvoxelPolygonizatorVertex(vecPos, Ogre::Vector3::UNIT_X));
                         }
                     }
                 }
-
-                for (long t = 0; t < nt; ++t)
-                {
-                    if (inverse)
-                    {
-                        indices.push_back(localVertexMapping[data.vertexIndex[t * 3 + 2]]);
-                        indices.push_back(localVertexMapping[data.vertexIndex[t * 3 + 1]]);
-                        indices.push_back(localVertexMapping[data.vertexIndex[t * 3 + 0]]);
-                        //indices.push_back(localVertexMapping[ptr[2]]);
-                        //indices.push_back(localVertexMapping[ptr[1]]);
-                        //indices.push_back(localVertexMapping[ptr[0]]);
-                    }
-                    else
-                    {
-                        indices.push_back(localVertexMapping[data.vertexIndex[t * 3 + 0]]);
-                        indices.push_back(localVertexMapping[data.vertexIndex[t * 3 + 1]]);
-                        indices.push_back(localVertexMapping[data.vertexIndex[t * 3 + 2]]);
-                        // indices.push_back(localVertexMapping[ptr[0]]);
-                        // indices.push_back(localVertexMapping[ptr[1]]);
-                        // indices.push_back(localVertexMapping[ptr[2]]);
-                    }
-                }
-
-                return nt;
             }
-        
-
 
-            void polygonizeCell(TerrainDataBlock* dataBlock, Vec3Int offsetPos, int lod) {
+            /**
+             * Cell must be non-trivial, caseCode comes from CellClassifier. Origin is density of voxel (0,0,0)
+             */
+            template<int BlockSize, int LodStep>
+            void polygonizeCell(BlockSizeState<BlockSize>& state, const int8_t* origin, Vec3Int offsetPos, uint8_t caseCode) {
 
                 uint8_t directionMask = (offsetPos.x > 0 ? 1 : 0) | ((offsetPos.z > 0 ? 1 : 0) << 1) | ((offsetPos.y > 0 ? 1 : 0) << 2);
 
-                std::vector<TerrainDataBlockNode> corners = {
-                    getNode(offsetPos.add(getCornerByIndex(0)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(1)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(2)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(3)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(4)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(5)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(6)) * lod),
-                    getNode(offsetPos.add(getCornerByIndex(7)) * lod),
-                };
-
-                auto caseCode = getCaseCode(corners);
-
-                if ((caseCode ^ ((corners[7].val >> 7) & 0xFF)) == 0) {
-                    return;
-                }
-
-                auto cornerNormals = new Ogre::Vector3[8];
+                //Everything per cell lives on the stack, so no heap allocations here
+                auto cellOrigin = origin + offsetPos.x + offsetPos.y * rowStride + offsetPos.z * sliceStride;
+                int8_t corners[8];
                 for (int i = 0; i < 8; i++)
                 {
-                    auto p = offsetPos.add(getCornerByIndex(i).mul(lod));
-                    float nx = (getNode(p.add({1,0,0})).val - getNode(p.add({-1, 0, 0})).val) * 0.5f;
-                    float ny = (getNode(p.add({0,1,0})).val - getNode(p.add({ 0,-1, 0})).val) * 0.5f;
-                    float nz = (getNode(p.add({0,0,1})).val - getNode(p.add({ 0, 0,-1})).val) * 0.5f;
-                    cornerNormals[i] = Ogre::Vector3(nx, ny, nz).normalisedCopy();
+                    corners[i] = cellOrigin[cornerOffsets[i]];
                 }
 
                 auto classVal = regularCellClass[caseCode];
@@ -1056,7 +1223,6 @@ class TransitionCache
                 auto cellData = regularCellData[classVal];
                 auto vertexCount = cellData.GetVertexCount();
                 auto triangleCount = cellData.GetTriangleCount();
-                auto indexOffset = cellData.vertexIndex;
                 int mappedIndizes[16]; //array with real indizes for current cell
 
                 for (int i = 0; i < vertexCount; i++)
@@ -1068,11 +1234,8 @@ class TransitionCache
                     auto v0 = (vertexLocations[i] >> 4) & 0x0F; //First Corner Index
                     auto v1 = (vertexLocations[i]) & 0x0F; //Second Corner Index
 
-                    auto d0 = corners[v0].val;
-                    auto d1 = corners[v1].val;
-
-                    Ogre::Vector3 n0 = cornerNormals[v0];
-                    Ogre::Vector3 n1 = cornerNormals[v1];
+                    int d0 = corners[v0];
+                    int d1 = corners[v1];
 
                     int t = (d1 << 8) / (d1 - d0);
                     int u = 0x0100 - t;
@@ -1083,21 +1246,24 @@ class TransitionCache
 
                     if (v1 != 7 && (rDir & directionMask) == rDir)
                     {
-                        ReuseCell cell = cache.GetReusedIndex(offsetPos, rDir);
-                        index = cell.verts[reuseIndex];
+                        index = state.cache.GetReusedIndex(offsetPos, rDir, reuseIndex);
                     }
 
                     if (index == -1)
                     {
-                        auto normal = cornerNormals[v0] * t0 + cornerNormals[v1] * t1;
-                        auto vertex = generateVertexPos(offsetPos, dataBlock->getPos(), lod, t, v0, v1);
-                        vertices.push_back(TransvoxelPolygonizatorVertex(vertex, normal));
-                        index = vertices.size() - 1;
+                        auto p0 = offsetPos.add(getCornerByIndex(v0));
+                        auto p1 = offsetPos.add(getCornerByIndex(v1));
+                        auto normal = state.gradients.getNormal(p0.x, p0.y, p0.z) * t0 + state.gradients.getNormal(p1.x, p1.y, p1.z) * t1;
+                        auto vertex = generateVertexPos(offsetPos, getScale<LodStep>(), t, v0, v1);
+                        if (transitionMask != 0) {
+                            vertex = getSecondaryPosition<BlockSize>(vertex, normal, getScale<LodStep>());
+                        }
+                        index = addVertex(vertex, normal);
                     }
 
                     if ((rDir & 8) != 0)
                     {
-                        cache.SetReusableIndex(offsetPos, reuseIndex, vertices.size() - 1);
+                        state.cache.SetReusableIndex(offsetPos, reuseIndex, index);
                     }
 
                     mappedIndizes[i] = index;
@@ -1107,60 +1273,255 @@ class TransitionCache
                 {
                     for (int i = 0; i < 3; i++)
                     {
-                        indices.push_back(mappedIndizes[cellData.vertexIndex[t * 3 + i]]);
+                        addIndex(mappedIndizes[cellData.vertexIndex[t * 3 + i]]);
                     }
                 }
 
             }
 
-            static std::vector<Vec3Int> getTransitionCellNodes(Vec3Int OpposingChunkPosition) {
-                
-                std::vector<Vec3Int> result;
-                result.push_back(Vec3Int(0));
-                result.push_back(Vec3Int(0));
-                
+            std::vector<uint32_t> activeCells;
+            std::tuple<std::unique_ptr<BlockSizeState<16>>, std::unique_ptr<BlockSizeState<32>>> blockSizeStates;
+            int rowStride = 0;
+            int sliceStride = 0;
+            //Offsets of the 8 corners of a cell in density data, in getCornerByIndex order
+            int cornerOffsets[8];
+            std::vector<TransvoxelPolygonizatorVertex> vertices;
+            std::vector<int> indices;
+            std::vector<TransvoxelPackedVertex> packedVertices;
+            std::vector<uint16_t> packedIndices;
+            VertexFormat vertexFormat = FULL;
+            //Format of the block being polygonized, FULL when a packed block outgrew 16 bit indices
+            VertexFormat activeFormat = FULL;
+            int currentLod = 1;
+            //Bit per face with a coarser neighbour, in the order of TerrainChunk::neghboursShifts
+            uint8_t transitionMask = 0;
+
+            /**
+             * Caches sized for given block size, created on first use
+             */
+            template<int BlockSize>
+            BlockSizeState<BlockSize>& getBlockSizeState() {
+                auto& state = std::get<std::unique_ptr<BlockSizeState<BlockSize>>>(blockSizeStates);
+                if (!state) {
+                    state = std::make_unique<BlockSizeState<BlockSize>>();
+                }
+                return *state;
+            }
+
+            /**
+             * Body of polygonizeBlock. Block size and LoD step are compile time constants here, so strides,
+             * loop bounds and position scaling fold. LodStep 0 handles LoDs without a specialization
+             */
+            template<int BlockSize, int LodStep>
+            void polygonizeSpecialized(BlockPart part) {
+                auto& state = getBlockSizeState<BlockSize>();
+                state.cache.reset();
+
+                //Typically only a small fraction of cells is crossed by the surface, so only those are visited.
+                //They come ordered by z, y, x, which is what RegularCellCache expects
+                auto origin = data->getDensityData() + data->getNodeIndex(Vec3Int(0));
+                CellClassifier::classify<BlockSize>(origin, rowStride, sliceStride, activeCells);
+
+                if (part != WHOLE) {
+                    const int last = BlockSize - 1;
+                    auto keepBoundary = part == BOUNDARY;
+                    auto removed = std::remove_if(activeCells.begin(), activeCells.end(), [&](uint32_t cell) {
+                        auto x = CellClassifier::getX(cell);
+                        auto y = CellClassifier::getY(cell);
+                        auto z = CellClassifier::getZ(cell);
+                        bool boundary = x == 0 || y == 0 || z == 0 || x == last || y == last || z == last;
+                        return boundary != keepBoundary;
+                    });
+                    activeCells.erase(removed, activeCells.end());
+                }
+
+                //If no boundary cell is crossed by the surface, no transition cell is either
+                if (activeCells.empty()) {
+                    return;
+                }
+
+                //Only slices touched by active cells need gradients, transition cells may need all of them
+                auto zFirst = transitionMask != 0 ? 0 : CellClassifier::getZ(activeCells.front());
+                auto zLast = transitionMask != 0 ? GradientField<BlockSize>::size - 1 : CellClassifier::getZ(activeCells.back()) + 1;
+                state.gradients.compute(origin, rowStride, sliceStride, zFirst, zLast);
 
+                for (auto cell : activeCells) {
+                    auto position = Vec3Int(CellClassifier::getX(cell), CellClassifier::getY(cell), CellClassifier::getZ(cell));
+                    polygonizeCell<BlockSize, LodStep>(state, origin, position, CellClassifier::getCaseCode(cell));
+                }
+
+                for (int face = 0; face < 6; face++) {
+                    if (transitionMask & (1 << face)) {
+                        polygonizeTransitionFace<BlockSize, LodStep>(state, face);
+                    }
+                }
             }
 
-            RegularCellCache cache;
-            TransitionCache tcahe;
-            std::vector<TransvoxelPolygonizatorVertex> vertices;
-            std::vector<int> indices;
+            template<int BlockSize>
+            void polygonizeBlockOfSize(BlockPart part) {
+                switch (currentLod) {
+                    case 1: polygonizeSpecialized<BlockSize, 1>(part); break;
+                    case 2: polygonizeSpecialized<BlockSize, 2>(part); break;
+                    case 3: polygonizeSpecialized<BlockSize, 4>(part); break;
+                    case 4: polygonizeSpecialized<BlockSize, 8>(part); break;
+                    default: polygonizeSpecialized<BlockSize, 0>(part); break;
+                }
+            }
 
-        public:
-            void PolygonizeSingleBlock(TerrainDataBlock* dataBlock, int lod) {
-                pos = dataBlock->getPos();
+            /**
+             * Moves packed geometry of current block to full buffers, the rest of the block is generated as full
+             */
+            void unpackBlock() {
+                //Output of a block is in one format, so full buffers only hold something when clear() was skipped
+                assert(vertices.empty() && indices.empty());
+                auto base = (int)vertices.size();
+                for(auto& vertex : packedVertices) {
+                    vertices.push_back(TransvoxelPolygonizatorVertex(vertex.getPosition(currentLod), vertex.getNormal()));
+                }
+                for(auto index : packedIndices) {
+                    indices.push_back(base + index);
+                }
+                packedVertices.clear();
+                packedIndices.clear();
+                activeFormat = FULL;
+            }
+
+            int addVertex(Ogre::Vector3 position, Ogre::Vector3 normal) {
+                if(activeFormat == PACKED && packedVertices.size() > std::numeric_limits<uint16_t>::max()) {
+                    unpackBlock();
+                }
+                if(activeFormat == PACKED) {
+                    packedVertices.push_back(TransvoxelPackedVertex::pack(position, normal, currentLod));
+                    return packedVertices.size() - 1;
+                }
+                vertices.push_back(TransvoxelPolygonizatorVertex(position, normal));
+                return vertices.size() - 1;
+            }
 
-                if(pos.x == 16 && pos.y == 0 && pos.z == 0) {
-                    PolygonizeTransitionCell({14,0,6}, pos, 2, 1);
-                    //PolygonizeTransitionCell({15,0,0}, pos, 2, 1);
+            void addIndex(int index) {
+                if(activeFormat == PACKED) {
+                    packedIndices.push_back(index);
                 } else {
-                    //if(lod == 1) {return;}
-                    for (int x = 0; x < 16 ; x++) {
-                        for (int y = 0; y < 16; y ++) {
-                            for (int z = 0; z < 16; z ++) {
-                                auto position = Vec3Int(x, y, z);
-                                polygonizeCell(dataBlock, position, lod);
-                            }
+                    indices.push_back(index);
+                }
+            }
+
+        public:
+            /**
+             * Format of generated geometry, only buffers of the selected format are filled.
+             * A 16^3 block never has more than 65k vertices, so 16 bit indices are always enough. 32^3 blocks
+             * reach that only with noise-like data, where every cell is crossed by the surface. Such a block is
+             * generated in full format instead, so consumers pick the format of every mesh by its filled buffers
+             */
+            void setVertexFormat(VertexFormat format) {
+                vertexFormat = format;
+            }
+
+            VertexFormat getVertexFormat() const {
+                return vertexFormat;
+            }
+
+            /**
+             * Drops generated geometry, so the instance can be used for another block.
+             * Capacity of vertex and index buffers is kept, so reused instance doesn't allocate once it has warmed up
+             */
+            void clear() {
+                vertices.clear();
+                indices.clear();
+                packedVertices.clear();
+                packedIndices.clear();
+            }
+
+            /**
+             * Block must have an apron of at least 2 voxels, since cells reach one voxel past the block and
+             * corner normals sample one more. Voxels are always read with unit step, so for lod > 1 the block
+             * must be of the matching level(see TerrainDataBlockStorage::requestBlock). Lod only scales output positions.
+             *
+             * @param neighbourLods LoDs of face neighbours, ordered as TerrainChunk::neghboursShifts. Transition cells
+             * are generated towards coarser ones. Missing entries are treated as same LoD
+             */
+            void polygonizeBlock(Vec3Int blockPos, std::shared_ptr<const TerrainDataBlockSnapshot> snapshot, int lod, BlockPart part, const std::vector<int>& neighbourLods) {
+                //Smaller aprons would make cells and gradients read past the stored data
+                assert(snapshot->getApron() >= TerrainDataBlock::defaultApron);
+                pos = blockPos;
+                data = std::move(snapshot);
+                currentLod = lod;
+                activeFormat = vertexFormat;
+                transitionMask = getTransitionMask(lod, part, neighbourLods);
+
+                rowStride = data->getStride();
+                sliceStride = rowStride * rowStride;
+                for (int i = 0; i < 8; i++) {
+                    auto corner = getCornerByIndex(i);
+                    cornerOffsets[i] = corner.x + corner.y * rowStride + corner.z * sliceStride;
+                }
+
+                //Sizes accepted by TerrainDataBlock::setBlockSize
+                switch (data->getSize()) {
+                    case 16: polygonizeBlockOfSize<16>(part); break;
+                    case 32: polygonizeBlockOfSize<32>(part); break;
+                    default: break;
+                }
+
+                data.reset();
+            }
+
+            /**
+             * Faces which get transition cells, bit n is face n in TerrainChunk::neghboursShifts order.
+             * Mesh depends on neighbours only through this mask
+             */
+            static uint8_t getTransitionMask(int lod, BlockPart part, const std::vector<int>& neighbourLods) {
+                uint8_t mask = 0;
+                if (part != INTERIOR) {
+                    for (int face = 0; face < 6 && face < (int)neighbourLods.size(); face++) {
+                        if (neighbourLods[face] > lod) {
+                            mask |= 1 << face;
                         }
-                    } 
+                    }
                 }
+                return mask;
             }
 
-            std::vector<TransvoxelPolygonizatorVertex> getVertices() {
-                return vertices;
+            void PolygonizeSingleBlock(TerrainDataBlock* dataBlock, int lod) {
+                polygonizeBlock(dataBlock->getPos(), dataBlock->snapshot(), lod, WHOLE, {});
+            }
+
+            void PolygonizeSingleBlock(TerrainDataBlock* dataBlock, int lod, const std::vector<int>& neighbourLods) {
+                polygonizeBlock(dataBlock->getPos(), dataBlock->snapshot(), lod, WHOLE, neighbourLods);
+            }
+
+            void PolygonizeInterior(TerrainDataBlock* dataBlock, int lod) {
+                polygonizeBlock(dataBlock->getPos(), dataBlock->snapshot(), lod, INTERIOR, {});
             }
 
-            std::vector<Ogre::Vector3> getVerticesPositions() {
-                std::vector<Ogre::Vector3> result;
-                std::transform(vertices.cbegin(), vertices.cend(), std::back_inserter(result),  [](auto& x) { return x.pos; });
-                return result;
+            void PolygonizeBoundary(TerrainDataBlock* dataBlock, int lod, const std::vector<int>& neighbourLods) {
+                polygonizeBlock(dataBlock->getPos(), dataBlock->snapshot(), lod, BOUNDARY, neighbourLods);
             }
 
-            std::vector<int> getIndices() {
+            /**
+             * Meshes given version of block contents, so the caller knows exactly which data the mesh was built from
+             */
+            void PolygonizeSnapshot(Vec3Int blockPos, std::shared_ptr<const TerrainDataBlockSnapshot> snapshot, int lod, BlockPart part, const std::vector<int>& neighbourLods) {
+                polygonizeBlock(blockPos, std::move(snapshot), lod, part, neighbourLods);
+            }
+
+            //Buffers stay valid until the next polygonization or clear(), copy them to keep the mesh
+            const std::vector<TransvoxelPolygonizatorVertex>& getVertices() const {
+                return vertices;
+            }
+
+            const std::vector<int>& getIndices() const {
                 return indices;
             }
 
+            const std::vector<TransvoxelPackedVertex>& getPackedVertices() const {
+                return packedVertices;
+            }
+
+            const std::vector<uint16_t>& getPackedIndices() const {
+                return packedIndices;
+            }
+
 
        
     };
@@ -0,0 +1,262 @@
+#include <Terrain/TerrainEditor/TerrainEditor.hpp>
+
+#include <cmath>
+
+namespace fluorite
+{
+
+    float TerrainEditBrush::distanceInside(Ogre::Vector3 point) const {
+        auto local = point - center;
+        if(shape == SPHERE) {
+            return extents.x - local.length();
+        }
+
+        //Box SDF, negated so inside is positive
+        auto q = Ogre::Vector3(std::abs(local.x) - extents.x, std::abs(local.y) - extents.y, std::abs(local.z) - extents.z);
+        auto outside = Ogre::Vector3(std::max(q.x, 0.0f), std::max(q.y, 0.0f), std::max(q.z, 0.0f)).length();
+        auto inside = std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+        return -(outside + inside);
+    }
+
+
+    TerrainEditor::TerrainEditor(TerrainDataBlockStorage* storage) : m_storage(storage) {}
+
+    std::optional<int> TerrainEditor::readDensity(TerrainDataBlockStorage* storage, Vec3Int worldPos) {
+        auto blockSize = TerrainDataBlock::getBlockSize();
+        auto blockPos = worldPos.align(blockSize);
+        auto block = storage->getBlockIfExists(blockPos);
+        if(!block) {
+            return std::nullopt;
+        }
+        return block->getNode(worldPos - blockPos).val;
+    }
+
+    void TerrainEditor::apply(const TerrainEditBrush& brush) {
+        auto blockSize = TerrainDataBlock::getBlockSize();
+
+        auto lo = Vec3Int(std::floor(brush.center.x - brush.extents.x) - 1, std::floor(brush.center.y - brush.extents.y) - 1, std::floor(brush.center.z - brush.extents.z) - 1);
+        auto hi = Vec3Int(std::ceil(brush.center.x + brush.extents.x) + 1, std::ceil(brush.center.y + brush.extents.y) + 1, std::ceil(brush.center.z + brush.extents.z) + 1);
+
+        //Blocks owning brush voxels. A voxel of a block that isn't loaded is not changed, not even in aprons of loaded
+        //neighbours, otherwise the apron would disagree with the block once it is generated
+        std::set<Vec3Int> owners;
+        auto firstBlock = lo.align(blockSize);
+        for(int bx = firstBlock.x; bx <= hi.x; bx += blockSize) {
+            for(int by = firstBlock.y; by <= hi.y; by += blockSize) {
+                for(int bz = firstBlock.z; bz <= hi.z; bz += blockSize) {
+                    auto blockPos = Vec3Int(bx, by, bz);
+                    if(m_storage->getBlockIfExists(blockPos)) {
+                        owners.insert(blockPos);
+                    }
+                }
+            }
+        }
+        if(owners.empty()) {
+            return;
+        }
+
+        //Smoothing reads neighbours, so their old values must be captured before anything is written
+        std::vector<std::optional<int>> smoothSource;
+        auto sourceLo = lo.substract(1);
+        auto sourceDim = hi.substract(lo).add(3);
+        auto sourceIndex = [&](Vec3Int p) {
+            auto l = p - sourceLo;
+            return l.x + sourceDim.x * (l.y + sourceDim.y * l.z);
+        };
+        if(brush.operation == TerrainEditBrush::SMOOTH) {
+            smoothSource.resize(sourceDim.x * sourceDim.y * sourceDim.z);
+            for(int z = sourceLo.z; z < sourceLo.z + sourceDim.z; z++) {
+                for(int y = sourceLo.y; y < sourceLo.y + sourceDim.y; y++) {
+                    for(int x = sourceLo.x; x < sourceLo.x + sourceDim.x; x++) {
+                        auto p = Vec3Int(x, y, z);
+                        smoothSource[sourceIndex(p)] = readDensity(m_storage, p);
+                    }
+                }
+            }
+        }
+
+        bool changed = false;
+        auto changedLo = Vec3Int(std::numeric_limits<int>::max());
+        auto changedHi = Vec3Int(std::numeric_limits<int>::min());
+
+        //Voxel is stored in its own block and in aprons of its neighbours. All copies get the same change
+        auto apron = m_storage->getApron();
+        auto firstCopy = lo.substract(apron).align(blockSize);
+        for(int bx = firstCopy.x; bx <= hi.x + apron; bx += blockSize) {
+            for(int by = firstCopy.y; by <= hi.y + apron; by += blockSize) {
+                for(int bz = firstCopy.z; bz <= hi.z + apron; bz += blockSize) {
+                    auto blockPos = Vec3Int(bx, by, bz);
+                    auto block = m_storage->getBlockIfExists(blockPos);
+                    if(!block) {
+                        continue;
+                    }
+                    auto contents = block->snapshot();
+                    std::shared_ptr<TerrainDataBlockSnapshot> newContents;
+
+                    auto localLo = Vec3Int(std::max(lo.x - bx, -apron), std::max(lo.y - by, -apron), std::max(lo.z - bz, -apron));
+                    auto localHi = Vec3Int(std::min(hi.x - bx, blockSize + apron - 1), std::min(hi.y - by, blockSize + apron - 1), std::min(hi.z - bz, blockSize + apron - 1));
+
+                    for(int z = localLo.z; z <= localHi.z; z++) {
+                        for(int y = localLo.y; y <= localHi.y; y++) {
+                            for(int x = localLo.x; x <= localHi.x; x++) {
+                                auto local = Vec3Int(x, y, z);
+                                auto world = blockPos + local;
+                                if(!owners.count(Vec3Int(world).align(blockSize))) {
+                                    continue;
+                                }
+                                auto inside = brush.distanceInside(OgreVecFromV3I(world));
+
+                                auto node = contents->getNode(local);
+                                auto newNode = node;
+
+                                switch(brush.operation) {
+                                    case TerrainEditBrush::ADD: {
+                                        float target = std::max<float>(node.val, inside * brush.sharpness);
+                                        newNode.val = std::clamp<int>(std::round(node.val + (target - node.val) * brush.strength), -127, 127);
+                                        break;
+                                    }
+                                    case TerrainEditBrush::SUBTRACT: {
+                                        float target = std::min<float>(node.val, -inside * brush.sharpness);
+                                        newNode.val = std::clamp<int>(std::round(node.val + (target - node.val) * brush.strength), -127, 127);
+                                        break;
+                                    }
+                                    case TerrainEditBrush::SMOOTH: {
+                                        if(inside <= 0) {break;}
+                                        //Neighbours in blocks that aren't loaded are unknown and left out of the average
+                                        float sum = 0;
+                                        int count = 0;
+                                        for(auto neighbour : {world, world + Vec3Int::unitX(), world - Vec3Int::unitX(), world + Vec3Int::unitY(),
+                                            world - Vec3Int::unitY(), world + Vec3Int::unitZ(), world - Vec3Int::unitZ()}) {
+                                            if(auto density = smoothSource[sourceIndex(neighbour)]) {
+                                                sum += *density;
+                                                count++;
+                                            }
+                                        }
+                                        float weight = brush.strength * std::min(inside, 1.0f);
+                                        newNode.val = std::clamp<int>(std::round(node.val + (sum / count - node.val) * weight), -127, 127);
+                                        break;
+                                    }
+                                    case TerrainEditBrush::PAINT: {
+                                        if(inside > 0) {
+                                            newNode.mat = brush.material;
+                                        }
+                                        break;
+                                    }
+                                }
+
+                                if(newNode.val != node.val || newNode.mat != node.mat) {
+                                    if(!newContents) {
+                                        newContents = block->beginWrite();
+                                    }
+                                    newContents->setNode(local, newNode);
+                                    changed = true;
+                                    for(int i = 0; i < 3; i++) {
+                                        changedLo[i] = std::min(changedLo[i], world[i]);
+                                        changedHi[i] = std::max(changedHi[i], world[i]);
+                                    }
+                                }
+                            }
+                        }
+                    }
+
+                    //Whole block is published at once, so readers never see half-applied brush
+                    if(newContents) {
+                        block->commit(std::move(newContents));
+                    }
+                }
+            }
+        }
+
+        if(changed) {
+            markVoxelsChanged(changedLo, changedHi);
+        }
+    }
+
+    void TerrainEditor::markVoxelsChanged(Vec3Int lo, Vec3Int hi) {
+        auto blockSize = TerrainDataBlock::getBlockSize();
+        if(!m_hasChangedVoxels) {
+            m_changedLo = lo;
+            m_changedHi = hi;
+            m_hasChangedVoxels = true;
+        }
+        for(int i = 0; i < 3; i++) {
+            m_changedLo[i] = std::min(m_changedLo[i], lo[i]);
+            m_changedHi[i] = std::max(m_changedHi[i], hi[i]);
+        }
+
+        auto cellLo = lo.substract(normalReach + 1);
+        auto cellHi = hi.add(normalReach);
+
+        auto firstBlock = cellLo.align(blockSize);
+        for(int bx = firstBlock.x; bx <= cellHi.x; bx += blockSize) {
+            for(int by = firstBlock.y; by <= cellHi.y; by += blockSize) {
+                for(int bz = firstBlock.z; bz <= cellHi.z; bz += blockSize) {
+                    auto blockPos = Vec3Int(bx, by, bz);
+                    auto block = m_storage->getBlockIfExists(blockPos);
+                    if(!block) {
+                        continue;
+                    }
+                    block->markDirty(cellLo - blockPos, cellHi - blockPos);
+                    m_dirtyBlocks.insert(blockPos);
+                }
+            }
+        }
+    }
+
+    bool TerrainEditor::hasPendingChanges() {
+        return !m_dirtyBlocks.empty();
+    }
+
+    std::vector<TerrainDirtyRegion> TerrainEditor::takeDirtyRegions() {
+        if(m_hasChangedVoxels) {
+            m_storage->refreshCoarseLevels(m_changedLo, m_changedHi);
+            m_hasChangedVoxels = false;
+        }
+
+        std::vector<TerrainDirtyRegion> result;
+        for(auto blockPos : m_dirtyBlocks) {
+            auto block = m_storage->getBlockIfExists(blockPos);
+            if(!block || !block->isDirty()) {
+                continue;
+            }
+            result.push_back({blockPos, block->getDirtyLo(), block->getDirtyHi()});
+            block->clearDirty();
+        }
+        m_dirtyBlocks.clear();
+        return result;
+    }
+
+    std::set<std::pair<int, Vec3Int>> TerrainEditor::submitRemeshes(TerrainMeshingService& service, Ogre::Vector3 viewer, int maxLevel) {
+        std::set<std::pair<int, Vec3Int>> submitted;
+
+        for(auto& region : takeDirtyRegions()) {
+            auto worldLo = region.blockPos + region.cellLo;
+            auto worldHi = region.blockPos + region.cellHi;
+
+            for(int level = 1; level <= maxLevel; level++) {
+                auto levelBlockSize = TerrainDataBlock::getLevelBlockSize(level);
+                //Cells of coarse levels are wider, so both corners and normals reach further
+                auto step = 1 << (level - 1);
+                auto lo = worldLo.substract((step - 1) * (normalReach + 1));
+                auto hi = worldHi.add((step - 1) * normalReach);
+
+                auto firstBlock = lo.align(levelBlockSize);
+                for(int x = firstBlock.x; x <= hi.x; x += levelBlockSize) {
+                    for(int y = firstBlock.y; y <= hi.y; y += levelBlockSize) {
+                        for(int z = firstBlock.z; z <= hi.z; z += levelBlockSize) {
+                            auto blockPos = Vec3Int(x, y, z);
+                            auto block = m_storage->getBlockIfExists(blockPos, level);
+                            if(!block || !submitted.insert({level, blockPos}).second) {
+                                continue;
+                            }
+                            auto center = OgreVecFromV3I(blockPos) + Ogre::Vector3(levelBlockSize * 0.5f);
+                            service.submit(block, level, center.distance(viewer));
+                        }
+                    }
+                }
+            }
+        }
+        return submitted;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+#include <Terrain/TerrainMeshing/TerrainMeshing.hpp>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace fluorite
+{
+
+    /**
+     * Describes a single modification of terrain data. Brush is defined in world voxel coordinates
+     */
+    struct TerrainEditBrush {
+        enum Shape {
+            SPHERE,
+            BOX,
+        };
+
+        enum Operation {
+            ADD,
+            SUBTRACT,
+            SMOOTH,
+            PAINT,
+        };
+
+        Shape shape = SPHERE;
+        Operation operation = ADD;
+        Ogre::Vector3 center = Ogre::Vector3::ZERO;
+        //Radius for spheres, half-size for boxes
+        Ogre::Vector3 extents = Ogre::Vector3(1, 1, 1);
+        //0..1, how much of the brush is applied in one call
+        float strength = 1.0f;
+        //Density change per voxel of distance from the brush surface
+        float sharpness = 4.0f;
+        uint16_t material = 0;
+
+        static TerrainEditBrush sphere(Ogre::Vector3 center, float radius, Operation operation) {
+            auto brush = TerrainEditBrush();
+            brush.shape = SPHERE;
+            brush.operation = operation;
+            brush.center = center;
+            brush.extents = Ogre::Vector3(radius, radius, radius);
+            return brush;
+        }
+
+        static TerrainEditBrush box(Ogre::Vector3 center, Ogre::Vector3 halfSize, Operation operation) {
+            auto brush = TerrainEditBrush();
+            brush.shape = BOX;
+            brush.operation = operation;
+            brush.center = center;
+            brush.extents = halfSize;
+            return brush;
+        }
+
+        /**
+         * Signed distance from point to brush surface. Positive inside of the brush
+         */
+        float distanceInside(Ogre::Vector3 point) const;
+    };
+
+    /**
+     * Part of a data block which must be remeshed. Cell coordinates are local to the block and inclusive
+     */
+    struct TerrainDirtyRegion {
+        Vec3Int blockPos;
+        Vec3Int cellLo;
+        Vec3Int cellHi;
+    };
+
+    /**
+     * Applies brushes to TerrainDataBlockStorage and keeps track of which blocks must be remeshed.
+     * Edits made during a frame are coalesced, so continuous digging still causes only one remesh per block per frame.
+     * Only loaded blocks are edited, voxels of blocks that don't exist yet are left to the generator
+     */
+    class TerrainEditor {
+        private:
+            TerrainDataBlockStorage* m_storage;
+            std::set<Vec3Int> m_dirtyBlocks;
+
+            //World voxels changed since last takeDirtyRegions(), coarse levels are rebuilt from them once per frame
+            bool m_hasChangedVoxels = false;
+            Vec3Int m_changedLo;
+            Vec3Int m_changedHi;
+
+            void markVoxelsChanged(Vec3Int lo, Vec3Int hi);
+            /**
+             * Empty when the block owning the voxel isn't loaded
+             */
+            static std::optional<int> readDensity(TerrainDataBlockStorage* storage, Vec3Int worldPos);
+
+        public:
+            /**
+             * Cells use corners up to +1 voxel, and corner normals sample one voxel further. So changing a voxel
+             * affects cells from -normalReach-1 to +normalReach of it, which spills into neighbouring blocks
+             */
+            static const int normalReach = 1;
+
+            TerrainEditor(TerrainDataBlockStorage* storage);
+
+            void apply(const TerrainEditBrush& brush);
+
+            bool hasPendingChanges();
+
+            /**
+             * Returns all regions changed since last call and resets dirty state of their blocks.
+             * Coarse levels of the storage are brought up to date before that
+             */
+            std::vector<TerrainDirtyRegion> takeDirtyRegions();
+
+            /**
+             * Submits every existing block intersecting changed regions to the meshing service, on every level up to maxLevel.
+             * Dirty regions already include neighbours the edit spilled into. Each block is submitted only once, no matter
+             * how many edits touched it. Should be called once per frame after all edits, so changes are visible on the next one
+             *
+             * @param viewer priority of the jobs is their distance from it
+             * @return level and position of submitted blocks, so their meshes can be told apart from streamed ones
+             */
+            std::set<std::pair<int, Vec3Int>> submitRemeshes(TerrainMeshingService& service, Ogre::Vector3 viewer, int maxLevel = 1);
+    };
+
+}
@@ -0,0 +1,77 @@
+#include <Terrain/TerrainMeshCache/TerrainMeshCache.hpp>
+
+namespace fluorite
+{
+
+    TerrainMeshCache::TerrainMeshCache(size_t budget) : m_budget(budget) {}
+
+    std::shared_ptr<const TerrainCachedMesh> TerrainMeshCache::find(const Key& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(key);
+        if(found == m_index.end()) {
+            m_stats.misses++;
+            return nullptr;
+        }
+        m_stats.hits++;
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return found->second->mesh;
+    }
+
+    void TerrainMeshCache::insert(const Key& key, std::shared_ptr<const TerrainCachedMesh> mesh) {
+        auto bytes = mesh->getByteSize();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(key);
+        if(found != m_index.end()) {
+            m_stats.bytes -= found->second->bytes;
+            m_stats.entries--;
+            m_entries.erase(found->second);
+            m_index.erase(found);
+        }
+        if(bytes > m_budget) {
+            return;
+        }
+
+        evict(m_budget - bytes);
+        m_entries.push_front({key, std::move(mesh), bytes});
+        m_index.insert({key, m_entries.begin()});
+        m_stats.bytes += bytes;
+        m_stats.entries++;
+    }
+
+    void TerrainMeshCache::evict(size_t budget) {
+        while(m_stats.bytes > budget) {
+            auto& last = m_entries.back();
+            m_stats.bytes -= last.bytes;
+            m_stats.entries--;
+            m_stats.evictions++;
+            m_index.erase(last.key);
+            m_entries.pop_back();
+        }
+    }
+
+    void TerrainMeshCache::setBudget(size_t budget) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budget = budget;
+        evict(budget);
+    }
+
+    size_t TerrainMeshCache::getBudget() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_budget;
+    }
+
+    void TerrainMeshCache::clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+        m_stats.entries = 0;
+        m_stats.bytes = 0;
+    }
+
+    TerrainMeshCache::Stats TerrainMeshCache::getStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+}
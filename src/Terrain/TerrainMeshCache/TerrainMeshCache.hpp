@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+#include <Terrain/TerrainMeshSimplifier/TerrainMeshSimplifier.hpp>
+#include <list>
+#include <mutex>
+
+namespace fluorite
+{
+
+    /**
+     * Finished geometry of a block, as stored in TerrainMeshCache. Positions are local to the block,
+     * so the same geometry is valid for any block with the same contents
+     */
+    struct TerrainCachedMesh {
+        std::vector<TransvoxelPolygonizatorVertex> vertices;
+        std::vector<int> indices;
+        std::vector<TransvoxelPackedVertex> packedVertices;
+        std::vector<uint16_t> packedIndices;
+        TerrainMeshSimplifier::Report simplification;
+
+        size_t getByteSize() const {
+            return vertices.size() * sizeof(TransvoxelPolygonizatorVertex) + indices.size() * sizeof(int)
+                + packedVertices.size() * sizeof(TransvoxelPackedVertex) + packedIndices.size() * sizeof(uint16_t);
+        }
+    };
+
+    /**
+     * Content addressed store of block meshes. Procedural terrain repeats a lot(empty air, solid rock, flat ground),
+     * and revisited areas are recreated with the same data, so such blocks skip polygonization entirely.
+     * Least recently used meshes are evicted once the memory budget is exceeded. Safe to use from several threads
+     */
+    class TerrainMeshCache {
+        public:
+            struct Key {
+                //TerrainDataBlockSnapshot::computeContentHash()
+                uint64_t contentHash;
+                int lod;
+                TransvoxelPolygonizator::BlockPart part;
+                //TransvoxelPolygonizator::getTransitionMask(), neighbour LoDs matter only through it
+                uint8_t transitionMask;
+                TransvoxelPolygonizator::VertexFormat vertexFormat;
+                //Simplification budget of the LoD, maxTriangles is -1 for meshes left as polygonized.
+                //Services sharing the cache may use different budgets
+                int maxTriangles = -1;
+                float maxError = 0;
+
+                bool operator <(const Key& rhs) const {
+                    return std::make_tuple(contentHash, lod, part, transitionMask, vertexFormat, maxTriangles, maxError)
+                        < std::make_tuple(rhs.contentHash, rhs.lod, rhs.part, rhs.transitionMask, rhs.vertexFormat, rhs.maxTriangles, rhs.maxError);
+                }
+            };
+
+            struct Stats {
+                int64_t hits = 0;
+                int64_t misses = 0;
+                int64_t evictions = 0;
+                int entries = 0;
+                size_t bytes = 0;
+
+                double getHitRate() const {
+                    return hits + misses > 0 ? (double)hits / (hits + misses) : 0.0;
+                }
+            };
+
+        private:
+            struct Entry {
+                Key key;
+                std::shared_ptr<const TerrainCachedMesh> mesh;
+                size_t bytes;
+            };
+
+            std::mutex m_mutex;
+            size_t m_budget;
+            //Most recently used first
+            std::list<Entry> m_entries;
+            std::map<Key, std::list<Entry>::iterator> m_index;
+            Stats m_stats;
+
+            void evict(size_t budget);
+
+        public:
+            /**
+             * @param budget maximum bytes of stored vertex and index data
+             */
+            TerrainMeshCache(size_t budget = 64 * 1024 * 1024);
+
+            TerrainMeshCache(const TerrainMeshCache&) = delete;
+            TerrainMeshCache& operator=(const TerrainMeshCache&) = delete;
+
+            /**
+             * @return stored mesh or nullptr. Counts as a hit or a miss
+             */
+            std::shared_ptr<const TerrainCachedMesh> find(const Key& key);
+
+            /**
+             * Stores mesh, replacing an existing one with the same key. Meshes bigger than the whole budget are not stored
+             */
+            void insert(const Key& key, std::shared_ptr<const TerrainCachedMesh> mesh);
+
+            void setBudget(size_t budget);
+            size_t getBudget();
+
+            void clear();
+            Stats getStats();
+    };
+
+}
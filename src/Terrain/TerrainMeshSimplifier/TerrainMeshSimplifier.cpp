@@ -0,0 +1,375 @@
+#include <Terrain/TerrainMeshSimplifier/TerrainMeshSimplifier.hpp>
+
+#include <cmath>
+
+namespace fluorite
+{
+
+    void TerrainMeshSimplifier::Quadric::addPlane(Ogre::Vector3 n, double d) {
+        double a = n.x, b = n.y, c = n.z;
+        m[0] += a * a; m[1] += a * b; m[2] += a * c; m[3] += a * d;
+        m[4] += b * b; m[5] += b * c; m[6] += b * d;
+        m[7] += c * c; m[8] += c * d;
+        m[9] += d * d;
+    }
+
+    TerrainMeshSimplifier::Quadric& TerrainMeshSimplifier::Quadric::operator +=(const Quadric& rhs) {
+        for(int i = 0; i < 10; i++) {
+            m[i] += rhs.m[i];
+        }
+        return *this;
+    }
+
+    double TerrainMeshSimplifier::Quadric::error(Ogre::Vector3 p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+            + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+            + m[7] * z * z + 2 * m[8] * z
+            + m[9];
+    }
+
+    bool TerrainMeshSimplifier::Quadric::findMinimum(Ogre::Vector3& result) const {
+        //Gradient of the error is zero at the minimum: A * p = -b, solved with Cramer's rule
+        double a00 = m[0], a01 = m[1], a02 = m[2];
+        double a11 = m[4], a12 = m[5], a22 = m[7];
+        double b0 = -m[3], b1 = -m[6], b2 = -m[8];
+
+        double c00 = a11 * a22 - a12 * a12;
+        double c01 = a02 * a12 - a01 * a22;
+        double c02 = a01 * a12 - a02 * a11;
+        double det = a00 * c00 + a01 * c01 + a02 * c02;
+        //Flat or cylindrical neighbourhoods have no single minimum
+        if(std::abs(det) < 1e-6) {
+            return false;
+        }
+
+        double c11 = a00 * a22 - a02 * a02;
+        double c12 = a01 * a02 - a00 * a12;
+        double c22 = a00 * a11 - a01 * a01;
+        result = Ogre::Vector3((c00 * b0 + c01 * b1 + c02 * b2) / det, (c01 * b0 + c11 * b1 + c12 * b2) / det, (c02 * b0 + c12 * b1 + c22 * b2) / det);
+        return true;
+    }
+
+    bool TerrainMeshSimplifier::computeCollapse(int kept, int removed, Collapse& collapse) {
+        if(m_locked[removed]) {
+            if(m_locked[kept]) {
+                return false;
+            }
+            std::swap(kept, removed);
+        }
+
+        auto quadric = m_quadrics[kept];
+        quadric += m_quadrics[removed];
+
+        auto pk = m_positions[kept];
+        auto pr = m_positions[removed];
+        auto bestTarget = pk;
+        auto bestCost = quadric.error(pk);
+
+        //Locked vertex stays in place, otherwise the cheapest of endpoints, midpoint and quadric minimum is taken
+        if(!m_locked[kept]) {
+            auto mid = (pk + pr) * 0.5f;
+            Ogre::Vector3 candidates[3] = {pr, mid, mid};
+            int count = 2;
+            Ogre::Vector3 optimal;
+            //Minimum far away from the edge comes from badly conditioned quadric, moving there would tear the surface
+            if(quadric.findMinimum(optimal) && optimal.distance(mid) <= pk.distance(pr)) {
+                candidates[count++] = optimal;
+            }
+            for(int i = 0; i < count; i++) {
+                auto cost = quadric.error(candidates[i]);
+                if(cost < bestCost) {
+                    bestCost = cost;
+                    bestTarget = candidates[i];
+                }
+            }
+        }
+
+        collapse = {std::max(bestCost, 0.0), kept, removed, bestTarget, m_versions[kept], m_versions[removed]};
+        return true;
+    }
+
+    void TerrainMeshSimplifier::pushCollapse(int kept, int removed) {
+        Collapse collapse;
+        if(computeCollapse(kept, removed, collapse)) {
+            m_heap.push_back(collapse);
+            std::push_heap(m_heap.begin(), m_heap.end());
+        }
+    }
+
+    void TerrainMeshSimplifier::pushEdgesOf(int vertex) {
+        for(auto triangle : m_vertexTriangles[vertex]) {
+            if(!m_triangleAlive[triangle]) {
+                continue;
+            }
+            for(int i = 0; i < 3; i++) {
+                auto other = m_triangles[triangle * 3 + i];
+                if(other != vertex) {
+                    pushCollapse(vertex, other);
+                }
+            }
+        }
+    }
+
+    bool TerrainMeshSimplifier::flipsTriangles(int vertex, int other, Ogre::Vector3 target) {
+        for(auto triangle : m_vertexTriangles[vertex]) {
+            auto corners = &m_triangles[triangle * 3];
+            if(!m_triangleAlive[triangle] || corners[0] == other || corners[1] == other || corners[2] == other) {
+                continue;
+            }
+
+            Ogre::Vector3 before[3];
+            Ogre::Vector3 after[3];
+            for(int i = 0; i < 3; i++) {
+                before[i] = m_positions[corners[i]];
+                after[i] = corners[i] == vertex ? target : before[i];
+            }
+            auto normalBefore = (before[1] - before[0]).crossProduct(before[2] - before[0]);
+            auto normalAfter = (after[1] - after[0]).crossProduct(after[2] - after[0]);
+            //Normals of vertices point into the solid like density gradients, so a triangle facing the right way
+            //points away from them. Zero area triangles come from zero densities and have only this orientation
+            auto outside = -(m_normals[corners[0]] + m_normals[corners[1]] + m_normals[corners[2]]);
+            if(normalBefore.squaredLength() < 1e-12f) {
+                if(normalAfter.squaredLength() >= 1e-12f && outside.dotProduct(normalAfter) <= 0) {
+                    return true;
+                }
+                continue;
+            }
+            if(normalBefore.dotProduct(normalAfter) <= 0 || (outside.dotProduct(normalBefore) > 0 && outside.dotProduct(normalAfter) <= 0)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool TerrainMeshSimplifier::keepsManifold(int kept, int removed) {
+        //Link condition: vertices adjacent to both ends must be exactly the apexes of triangles sharing the edge,
+        //otherwise the collapse would glue two sheets of the surface together
+        m_neighbours.clear();
+        int sharedTriangles = 0;
+        for(auto triangle : m_vertexTriangles[removed]) {
+            if(!m_triangleAlive[triangle]) {
+                continue;
+            }
+            auto corners = &m_triangles[triangle * 3];
+            bool shared = corners[0] == kept || corners[1] == kept || corners[2] == kept;
+            sharedTriangles += shared ? 1 : 0;
+            for(int i = 0; i < 3; i++) {
+                if(corners[i] != removed && corners[i] != kept) {
+                    m_neighbours.push_back(corners[i]);
+                }
+            }
+        }
+        std::sort(m_neighbours.begin(), m_neighbours.end());
+        m_neighbours.erase(std::unique(m_neighbours.begin(), m_neighbours.end()), m_neighbours.end());
+
+        int common = 0;
+        for(auto neighbour : m_neighbours) {
+            for(auto triangle : m_vertexTriangles[kept]) {
+                auto corners = &m_triangles[triangle * 3];
+                if(m_triangleAlive[triangle] && (corners[0] == neighbour || corners[1] == neighbour || corners[2] == neighbour)) {
+                    common++;
+                    break;
+                }
+            }
+        }
+        return common == sharedTriangles;
+    }
+
+    TerrainMeshSimplifier::Report TerrainMeshSimplifier::run(float blockExtent, const Budget& budget) {
+        int vertexCount = m_positions.size();
+        int triangleCount = m_triangles.size() / 3;
+        auto report = Report();
+        report.trianglesBefore = triangleCount;
+
+        m_quadrics.assign(vertexCount, Quadric());
+        m_locked.assign(vertexCount, false);
+        m_versions.assign(vertexCount, 0);
+        m_parent.resize(vertexCount);
+        m_triangleAlive.assign(triangleCount, true);
+        if((int)m_vertexTriangles.size() < vertexCount) {
+            m_vertexTriangles.resize(vertexCount);
+        }
+        for(int i = 0; i < vertexCount; i++) {
+            m_parent[i] = i;
+            m_vertexTriangles[i].clear();
+        }
+
+        m_edges.clear();
+        for(int t = 0; t < triangleCount; t++) {
+            auto corners = &m_triangles[t * 3];
+            auto p0 = m_positions[corners[0]];
+            auto normal = (m_positions[corners[1]] - p0).crossProduct(m_positions[corners[2]] - p0);
+            auto length = normal.length();
+            for(int i = 0; i < 3; i++) {
+                if(length > 1e-6f) {
+                    m_quadrics[corners[i]].addPlane(normal / length, -(normal / length).dotProduct(p0));
+                }
+                m_vertexTriangles[corners[i]].push_back(t);
+                auto a = (uint64_t)std::min(corners[i], corners[(i + 1) % 3]);
+                auto b = (uint64_t)std::max(corners[i], corners[(i + 1) % 3]);
+                m_edges.push_back(a << 32 | b);
+            }
+        }
+
+        //Edges not shared by exactly two triangles are open borders of the mesh or non-manifold, their vertices never move
+        std::sort(m_edges.begin(), m_edges.end());
+        for(size_t i = 0; i < m_edges.size();) {
+            size_t j = i;
+            while(j < m_edges.size() && m_edges[j] == m_edges[i]) {
+                j++;
+            }
+            if(j - i != 2) {
+                m_locked[m_edges[i] >> 32] = true;
+                m_locked[m_edges[i] & 0xFFFFFFFF] = true;
+            }
+            i = j;
+        }
+        const float epsilon = 1e-3f;
+        for(int v = 0; v < vertexCount; v++) {
+            for(int axis = 0; axis < 3; axis++) {
+                if(m_positions[v][axis] <= epsilon || m_positions[v][axis] >= blockExtent - epsilon) {
+                    m_locked[v] = true;
+                }
+            }
+        }
+
+        m_heap.clear();
+        m_edges.erase(std::unique(m_edges.begin(), m_edges.end()), m_edges.end());
+        for(auto edge : m_edges) {
+            pushCollapse(edge >> 32, edge & 0xFFFFFFFF);
+        }
+
+        double maxCost = (double)budget.maxError * budget.maxError;
+        double worstCost = 0;
+        int alive = triangleCount;
+        while(alive > budget.maxTriangles && !m_heap.empty()) {
+            std::pop_heap(m_heap.begin(), m_heap.end());
+            auto collapse = m_heap.back();
+            m_heap.pop_back();
+
+            auto kept = collapse.kept;
+            auto removed = collapse.removed;
+            if(m_parent[kept] != kept || m_parent[removed] != removed
+                || m_versions[kept] != collapse.keptVersion || m_versions[removed] != collapse.removedVersion) {
+                continue;
+            }
+            //Heap is ordered by cost, so every remaining collapse is at least as bad
+            if(collapse.cost > maxCost) {
+                break;
+            }
+            //Rejected collapse is computed again once one of its vertices changes
+            if(!keepsManifold(kept, removed) || flipsTriangles(kept, removed, collapse.target) || flipsTriangles(removed, kept, collapse.target)) {
+                continue;
+            }
+
+            //Normal is interpolated along the edge at the projection of the new position
+            auto pk = m_positions[kept];
+            auto edge = m_positions[removed] - pk;
+            auto t = edge.squaredLength() > 0 ? std::clamp(edge.dotProduct(collapse.target - pk) / edge.squaredLength(), 0.0f, 1.0f) : 0.0f;
+            m_normals[kept] = (m_normals[kept] * (1 - t) + m_normals[removed] * t).normalisedCopy();
+            m_positions[kept] = collapse.target;
+            m_quadrics[kept] += m_quadrics[removed];
+            m_parent[removed] = kept;
+            m_versions[kept]++;
+            m_versions[removed]++;
+            worstCost = std::max(worstCost, collapse.cost);
+
+            for(auto triangle : m_vertexTriangles[removed]) {
+                if(!m_triangleAlive[triangle]) {
+                    continue;
+                }
+                auto corners = &m_triangles[triangle * 3];
+                if(corners[0] == kept || corners[1] == kept || corners[2] == kept) {
+                    m_triangleAlive[triangle] = false;
+                    alive--;
+                    continue;
+                }
+                for(int i = 0; i < 3; i++) {
+                    if(corners[i] == removed) {
+                        corners[i] = kept;
+                    }
+                }
+                m_vertexTriangles[kept].push_back(triangle);
+            }
+            //Lists of other vertices may keep dead triangles, they are skipped wherever lists are read
+            auto& keptTriangles = m_vertexTriangles[kept];
+            keptTriangles.erase(std::remove_if(keptTriangles.begin(), keptTriangles.end(), [&](int triangle) { return !m_triangleAlive[triangle]; }), keptTriangles.end());
+
+            pushEdgesOf(kept);
+        }
+
+        //Alive triangles are compacted in place, vertices are remapped in order of first use
+        m_remap.assign(vertexCount, -1);
+        int written = 0;
+        for(int t = 0; t < triangleCount; t++) {
+            if(!m_triangleAlive[t]) {
+                continue;
+            }
+            for(int i = 0; i < 3; i++) {
+                m_triangles[written * 3 + i] = m_triangles[t * 3 + i];
+            }
+            written++;
+        }
+        m_triangles.resize(written * 3);
+
+        report.trianglesAfter = written;
+        report.maxError = (float)std::sqrt(worstCost);
+        return report;
+    }
+
+    TerrainMeshSimplifier::Report TerrainMeshSimplifier::simplify(std::vector<TransvoxelPolygonizatorVertex>& vertices, std::vector<int>& indices, int lod, const Budget& budget) {
+        if((int)indices.size() / 3 <= budget.maxTriangles) {
+            return {(int)indices.size() / 3, (int)indices.size() / 3, 0};
+        }
+
+        m_positions.clear();
+        m_normals.clear();
+        for(auto& vertex : vertices) {
+            m_positions.push_back(vertex.pos);
+            m_normals.push_back(vertex.normal);
+        }
+        m_triangles.assign(indices.begin(), indices.end());
+
+        auto report = run((float)TerrainDataBlock::getLevelBlockSize(lod), budget);
+
+        vertices.clear();
+        indices.clear();
+        for(auto index : m_triangles) {
+            if(m_remap[index] < 0) {
+                m_remap[index] = vertices.size();
+                vertices.push_back(TransvoxelPolygonizatorVertex(m_positions[index], m_normals[index]));
+            }
+            indices.push_back(m_remap[index]);
+        }
+        return report;
+    }
+
+    TerrainMeshSimplifier::Report TerrainMeshSimplifier::simplify(std::vector<TransvoxelPackedVertex>& vertices, std::vector<uint16_t>& indices, int lod, const Budget& budget) {
+        if((int)indices.size() / 3 <= budget.maxTriangles) {
+            return {(int)indices.size() / 3, (int)indices.size() / 3, 0};
+        }
+
+        m_positions.clear();
+        m_normals.clear();
+        for(auto& vertex : vertices) {
+            m_positions.push_back(vertex.getPosition(lod));
+            m_normals.push_back(Ogre::Vector3(vertex.normal[0], vertex.normal[1], vertex.normal[2]) / 127.0f);
+        }
+        m_triangles.assign(indices.begin(), indices.end());
+
+        auto report = run((float)TerrainDataBlock::getLevelBlockSize(lod), budget);
+
+        vertices.clear();
+        indices.clear();
+        for(auto index : m_triangles) {
+            if(m_remap[index] < 0) {
+                m_remap[index] = vertices.size();
+                vertices.push_back(TransvoxelPackedVertex::pack(m_positions[index], m_normals[index], lod));
+            }
+            indices.push_back(m_remap[index]);
+        }
+        return report;
+    }
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * Reduces triangle count of block meshes by quadric error edge collapses(Garland-Heckbert). Meant for distant
+     * LoDs, where flat ground is covered by many nearly coplanar triangles. Vertices on open edges of the mesh and on
+     * faces of the block never move, so seams with neighbours and transition cells stay watertight.
+     * Scratch buffers are reused, so an instance should be owned by a single thread
+     */
+    class TerrainMeshSimplifier {
+        public:
+            struct Budget {
+                //Collapsing stops once the mesh has no more triangles than this
+                int maxTriangles = 0;
+                //Largest allowed distance of a moved vertex from the planes of its original triangles, in world voxels
+                float maxError = 0.5f;
+            };
+
+            /**
+             * Budgets per LoD. LoDs without a budget are left as they are
+             */
+            struct Settings {
+                std::map<int, Budget> lods;
+
+                const Budget* find(int lod) const {
+                    auto budget = lods.find(lod);
+                    return budget != lods.end() ? &budget->second : nullptr;
+                }
+            };
+
+            struct Report {
+                int trianglesBefore = 0;
+                int trianglesAfter = 0;
+                //Largest error of all collapses, in world voxels
+                float maxError = 0;
+            };
+
+        private:
+            //Symmetric 4x4 matrix of summed squared plane distances, upper triangle only
+            struct Quadric {
+                double m[10] = {};
+
+                void addPlane(Ogre::Vector3 n, double d);
+                Quadric& operator +=(const Quadric& rhs);
+                double error(Ogre::Vector3 p) const;
+                bool findMinimum(Ogre::Vector3& result) const;
+            };
+
+            struct Collapse {
+                double cost;
+                int kept;
+                int removed;
+                Ogre::Vector3 target;
+                //Versions of both vertices when the collapse was computed, stale entries are skipped
+                int keptVersion;
+                int removedVersion;
+
+                bool operator <(const Collapse& rhs) const {
+                    return cost > rhs.cost;
+                }
+            };
+
+            std::vector<Ogre::Vector3> m_positions;
+            std::vector<Ogre::Vector3> m_normals;
+            std::vector<Quadric> m_quadrics;
+            std::vector<bool> m_locked;
+            std::vector<int> m_versions;
+            //Collapsed vertex points to the vertex it was merged into
+            std::vector<int> m_parent;
+            std::vector<std::vector<int>> m_vertexTriangles;
+            std::vector<int> m_triangles;
+            std::vector<bool> m_triangleAlive;
+            //Heap ordered by Collapse::operator <, cheapest collapse first
+            std::vector<Collapse> m_heap;
+            std::vector<uint64_t> m_edges;
+            std::vector<int> m_neighbours;
+            std::vector<int> m_remap;
+
+            bool computeCollapse(int kept, int removed, Collapse& collapse);
+            bool flipsTriangles(int vertex, int other, Ogre::Vector3 target);
+            bool keepsManifold(int kept, int removed);
+            void pushCollapse(int kept, int removed);
+            void pushEdgesOf(int vertex);
+
+            /**
+             * Core pass over m_positions, m_normals and m_triangles. Vertices with coordinates at 0 or blockExtent lie
+             * on block faces and are locked
+             */
+            Report run(float blockExtent, const Budget& budget);
+
+        public:
+            /**
+             * Simplifies mesh in TransvoxelPolygonizator::FULL format in place. Unused vertices are removed
+             */
+            Report simplify(std::vector<TransvoxelPolygonizatorVertex>& vertices, std::vector<int>& indices, int lod, const Budget& budget);
+
+            /**
+             * Simplifies mesh in TransvoxelPolygonizator::PACKED format in place. Moved vertices are rounded to the packed grid
+             */
+            Report simplify(std::vector<TransvoxelPackedVertex>& vertices, std::vector<uint16_t>& indices, int lod, const Budget& budget);
+    };
+
+}
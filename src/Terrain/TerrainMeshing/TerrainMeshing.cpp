@@ -0,0 +1,212 @@
+#include <Terrain/TerrainMeshing/TerrainMeshing.hpp>
+
+#include <chrono>
+
+namespace fluorite
+{
+
+    TerrainMeshingService::TerrainMeshingService(int threads, TransvoxelPolygonizator::VertexFormat vertexFormat) : m_vertexFormat(vertexFormat) {
+        if(threads <= 0) {
+            threads = std::max<int>(1, (int)std::thread::hardware_concurrency() - 1);
+        }
+        for(int i = 0; i < threads; i++) {
+            m_workers.emplace_back([this](){ workerLoop(); });
+        }
+    }
+
+    TerrainMeshingService::~TerrainMeshingService() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_hasJobs.notify_all();
+        for(auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    void TerrainMeshingService::workerLoop() {
+        TransvoxelPolygonizator polygonizator;
+        polygonizator.setVertexFormat(m_vertexFormat);
+        TerrainMeshSimplifier simplifier;
+
+        while(true) {
+            Job job;
+            TerrainMeshCache* cache;
+            std::shared_ptr<const TerrainMeshSimplifier::Settings> simplification;
+            int occluderCellSize;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_hasJobs.wait(lock, [this](){ return m_stop || !m_queue.empty(); });
+                if(m_stop) {
+                    return;
+                }
+                job = *m_queue.begin();
+                m_queued.erase(job.key);
+                m_queue.erase(m_queue.begin());
+                m_running++;
+                cache = m_cache;
+                simplification = m_simplification;
+                occluderCellSize = m_occluderCellSize;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            //Mesh is built from exactly the contents it is cached under, even if the block is edited meanwhile.
+            //Version comes from the same snapshot, never from the block, so an edit can't tag the mesh with a version it wasn't built from
+            auto snapshot = job.block->snapshot();
+            auto version = snapshot->getVersion();
+            auto budget = simplification ? simplification->find(job.key.lod) : nullptr;
+            auto cacheKey = TerrainMeshCache::Key();
+            std::shared_ptr<const TerrainCachedMesh> mesh;
+            if(cache) {
+                cacheKey = {snapshot->computeContentHash(), job.key.lod, job.key.part,
+                    TransvoxelPolygonizator::getTransitionMask(job.key.lod, job.key.part, job.neighbourLods), m_vertexFormat};
+                if(budget) {
+                    cacheKey.maxTriangles = budget->maxTriangles;
+                    cacheKey.maxError = budget->maxError;
+                }
+                mesh = cache->find(cacheKey);
+            }
+
+            auto result = TerrainMeshResult();
+            result.blockPos = job.key.blockPos;
+            result.lod = job.key.lod;
+            result.part = job.key.part;
+            result.version = version;
+            if(mesh) {
+                result.vertices = mesh->vertices;
+                result.indices = mesh->indices;
+                result.packedVertices = mesh->packedVertices;
+                result.packedIndices = mesh->packedIndices;
+                result.simplification = mesh->simplification;
+            } else {
+                polygonizator.clear();
+                polygonizator.PolygonizeSnapshot(job.key.blockPos, snapshot, job.key.lod, job.key.part, job.neighbourLods);
+                result.vertices = polygonizator.getVertices();
+                result.indices = polygonizator.getIndices();
+                result.packedVertices = polygonizator.getPackedVertices();
+                result.packedIndices = polygonizator.getPackedIndices();
+
+                if(budget) {
+                    //Packed blocks too large for 16 bit indices come in full format
+                    if(!result.packedIndices.empty()) {
+                        result.simplification = simplifier.simplify(result.packedVertices, result.packedIndices, job.key.lod, *budget);
+                    } else {
+                        result.simplification = simplifier.simplify(result.vertices, result.indices, job.key.lod, *budget);
+                    }
+                }
+
+                if(cache) {
+                    cache->insert(cacheKey, std::make_shared<TerrainCachedMesh>(TerrainCachedMesh({result.vertices, result.indices, result.packedVertices, result.packedIndices,
+                        result.simplification})));
+                }
+            }
+
+            //Occluders depend only on densities, so they are extracted even when mesh comes from cache
+            if(occluderCellSize > 0 && job.key.part != TransvoxelPolygonizator::BOUNDARY) {
+                TerrainOccluders::extract(*snapshot, occluderCellSize, result.occluders);
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.completed++;
+                m_stats.busySeconds += std::chrono::duration<double>(end - start).count();
+                m_stats.trianglesRemoved += result.simplification.trianglesBefore - result.simplification.trianglesAfter;
+                m_stats.maxSimplificationError = std::max(m_stats.maxSimplificationError, result.simplification.maxError);
+                m_completed.push_back(std::move(result));
+                m_running--;
+                if(m_running == 0 && m_queue.empty()) {
+                    m_becameIdle.notify_all();
+                }
+            }
+        }
+    }
+
+    void TerrainMeshingService::submit(std::shared_ptr<TerrainDataBlock> block, int lod, float distance,
+        TransvoxelPolygonizator::BlockPart part, std::vector<int> neighbourLods) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto key = JobKey({block->getPos(), lod, part});
+
+            auto queued = m_queued.find(key);
+            if(queued != m_queued.end()) {
+                m_queue.erase(queued->second);
+                m_queued.erase(queued);
+                m_stats.dropped++;
+            }
+
+            auto job = Job({distance + lodBias * (lod - 1), m_sequence++, key, block, std::move(neighbourLods)});
+            m_queued.insert({key, m_queue.insert(job).first});
+            m_stats.submitted++;
+        }
+        m_hasJobs.notify_one();
+    }
+
+    void TerrainMeshingService::cancel(Vec3Int blockPos, int lod, TransvoxelPolygonizator::BlockPart part) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto queued = m_queued.find({blockPos, lod, part});
+        if(queued != m_queued.end()) {
+            m_queue.erase(queued->second);
+            m_queued.erase(queued);
+            m_stats.dropped++;
+        }
+    }
+
+    void TerrainMeshingService::setSimplification(TerrainMeshSimplifier::Settings settings) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_simplification = std::make_shared<const TerrainMeshSimplifier::Settings>(std::move(settings));
+    }
+
+    void TerrainMeshingService::setOccluderExtraction(int cellSize) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_occluderCellSize = cellSize;
+    }
+
+    void TerrainMeshingService::setMeshCache(TerrainMeshCache* cache) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cache = cache;
+    }
+
+    std::vector<TerrainMeshResult> TerrainMeshingService::takeCompleted() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<TerrainMeshResult> result;
+        std::swap(result, m_completed);
+        return result;
+    }
+
+    void TerrainMeshingService::waitIdle() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_becameIdle.wait(lock, [this](){ return m_running == 0 && m_queue.empty(); });
+    }
+
+    int TerrainMeshingService::getWorkersCount() {
+        return m_workers.size();
+    }
+
+    int TerrainMeshingService::getQueueSize() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+
+    TerrainMeshingService::Stats TerrainMeshingService::getStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    double TerrainMeshingService::measureThroughput(std::vector<std::shared_ptr<TerrainDataBlock>> blocks, int lod, int threads) {
+        auto service = TerrainMeshingService(threads);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(auto& block : blocks) {
+            service.submit(block, lod, 0);
+        }
+        service.waitIdle();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        return blocks.size() / std::chrono::duration<double>(end - start).count();
+    }
+
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+#include <Terrain/TerrainMeshCache/TerrainMeshCache.hpp>
+#include <Terrain/TerrainMeshSimplifier/TerrainMeshSimplifier.hpp>
+#include <Terrain/TerrainOccluders/TerrainOccluders.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <span>
+
+namespace fluorite
+{
+
+    /**
+     * Geometry of a single data block, produced by TerrainMeshingService
+     */
+    struct TerrainMeshResult {
+        Vec3Int blockPos;
+        int lod;
+        TransvoxelPolygonizator::BlockPart part;
+        //Version of block contents the mesh was built from
+        uint64_t version;
+        //Only buffers of the service vertex format are filled
+        std::vector<TransvoxelPolygonizatorVertex> vertices;
+        std::vector<int> indices;
+        std::vector<TransvoxelPackedVertex> packedVertices;
+        std::vector<uint16_t> packedIndices;
+        //Filled when the mesh was simplified, meshes taken from cache carry the report of the build they come from
+        TerrainMeshSimplifier::Report simplification;
+        //Filled when occluder extraction is on, never for BOUNDARY part
+        std::vector<TerrainOccluderBox> occluders;
+    };
+
+    /**
+     * Geometry of a single block without owning it, either of a TerrainMeshResult or straight of polygonizer buffers.
+     * Renderer writes it into hardware buffers as it is, so viewed buffers only have to live until the call returns
+     */
+    struct TerrainMeshView {
+        Vec3Int blockPos;
+        int lod;
+        std::span<const TransvoxelPolygonizatorVertex> vertices;
+        std::span<const int> indices;
+        std::span<const TransvoxelPackedVertex> packedVertices;
+        std::span<const uint16_t> packedIndices;
+
+        TerrainMeshView(const TerrainMeshResult& mesh) : blockPos(mesh.blockPos), lod(mesh.lod), vertices(mesh.vertices), indices(mesh.indices),
+            packedVertices(mesh.packedVertices), packedIndices(mesh.packedIndices) {}
+
+        /**
+         * Last mesh built by polygonizator, valid until it polygonizes again
+         */
+        TerrainMeshView(const TransvoxelPolygonizator& polygonizator, Vec3Int blockPos, int lod) : blockPos(blockPos), lod(lod),
+            vertices(polygonizator.getVertices()), indices(polygonizator.getIndices()),
+            packedVertices(polygonizator.getPackedVertices()), packedIndices(polygonizator.getPackedIndices()) {}
+
+        bool isEmpty() const {
+            return indices.empty() && packedIndices.empty();
+        }
+    };
+
+    /**
+     * Polygonizes data blocks on a pool of worker threads. Every worker owns its polygonizer, and reads blocks
+     * through pinned snapshots, so meshing never blocks edits. Jobs are taken nearest first, finer LoDs before
+     * coarser ones at the same distance. Finished meshes are collected on the calling thread with takeCompleted()
+     */
+    class TerrainMeshingService {
+        public:
+            struct Stats {
+                int submitted = 0;
+                int completed = 0;
+                //Jobs replaced by a newer submission of the same block, or cancelled, before they started
+                int dropped = 0;
+                //Summed over all workers
+                double busySeconds = 0;
+                int64_t trianglesRemoved = 0;
+                //Largest simplification error of any mesh, in world voxels
+                float maxSimplificationError = 0;
+            };
+
+        private:
+            struct JobKey {
+                Vec3Int blockPos;
+                int lod;
+                TransvoxelPolygonizator::BlockPart part;
+                bool operator <(const JobKey& rhs) const  {
+                    return std::make_tuple(lod, part, blockPos.x, blockPos.y, blockPos.z) < std::make_tuple(rhs.lod, rhs.part, rhs.blockPos.x, rhs.blockPos.y, rhs.blockPos.z);
+                }
+            };
+
+            struct Job {
+                float priority;
+                uint64_t sequence;
+                JobKey key;
+                std::shared_ptr<TerrainDataBlock> block;
+                std::vector<int> neighbourLods;
+
+                bool operator <(const Job& rhs) const {
+                    return std::make_tuple(priority, sequence) < std::make_tuple(rhs.priority, rhs.sequence);
+                }
+            };
+
+            std::vector<std::thread> m_workers;
+            std::mutex m_mutex;
+            std::condition_variable m_hasJobs;
+            std::condition_variable m_becameIdle;
+            TransvoxelPolygonizator::VertexFormat m_vertexFormat;
+            TerrainMeshCache* m_cache = nullptr;
+            std::shared_ptr<const TerrainMeshSimplifier::Settings> m_simplification;
+            int m_occluderCellSize = 0;
+            bool m_stop = false;
+            int m_running = 0;
+            uint64_t m_sequence = 0;
+
+            std::set<Job> m_queue;
+            std::map<JobKey, std::set<Job>::iterator> m_queued;
+            std::vector<TerrainMeshResult> m_completed;
+            Stats m_stats;
+
+            void workerLoop();
+
+        public:
+            /**
+             * Extra priority added per LoD step, in the same units as distance
+             */
+            float lodBias = 16.0f;
+
+            /**
+             * @param threads number of workers. 0 uses all hardware threads but one, which is left for the game loop
+             * @param vertexFormat format of produced meshes
+             */
+            TerrainMeshingService(int threads = 0, TransvoxelPolygonizator::VertexFormat vertexFormat = TransvoxelPolygonizator::FULL);
+            ~TerrainMeshingService();
+
+            TerrainMeshingService(const TerrainMeshingService&) = delete;
+            TerrainMeshingService& operator=(const TerrainMeshingService&) = delete;
+
+            /**
+             * Queues block for meshing. If the same part of the block at the same lod is still waiting, it is replaced by this one.
+             * Interior and boundary are separate jobs, so a change of neighbour lods only costs a boundary remesh
+             *
+             * @param neighbourLods lods of face neighbours(see TransvoxelPolygonizator::PolygonizeSingleBlock), ignored for INTERIOR
+             */
+            void submit(std::shared_ptr<TerrainDataBlock> block, int lod, float distance,
+                TransvoxelPolygonizator::BlockPart part = TransvoxelPolygonizator::WHOLE, std::vector<int> neighbourLods = {});
+
+            /**
+             * Removes job from the queue, if it hasn't been started yet
+             */
+            void cancel(Vec3Int blockPos, int lod, TransvoxelPolygonizator::BlockPart part = TransvoxelPolygonizator::WHOLE);
+
+            /**
+             * Blocks with contents already meshed are taken from the cache instead of being polygonized.
+             * Cache may be shared by several services and must outlive them. nullptr disables caching
+             */
+            void setMeshCache(TerrainMeshCache* cache);
+
+            /**
+             * Simplifies meshes of LoDs with a budget on worker threads, right after polygonization. Cached meshes are
+             * keyed by the budget they were simplified with, so changed budgets never pick up stale ones
+             */
+            void setSimplification(TerrainMeshSimplifier::Settings settings);
+
+            /**
+             * Every mesh gets occluders of its block(see TerrainOccluders), extracted from the same contents as the mesh
+             * @param cellSize passed to TerrainOccluders::extract, 0 turns extraction off
+             */
+            void setOccluderExtraction(int cellSize);
+
+            std::vector<TerrainMeshResult> takeCompleted();
+
+            /**
+             * Blocks until queue is empty and no worker is busy
+             */
+            void waitIdle();
+
+            int getWorkersCount();
+            int getQueueSize();
+            Stats getStats();
+
+            /**
+             * Meshes all blocks with given number of threads and returns achieved throughput in blocks per second
+             */
+            static double measureThroughput(std::vector<std::shared_ptr<TerrainDataBlock>> blocks, int lod, int threads);
+    };
+
+}
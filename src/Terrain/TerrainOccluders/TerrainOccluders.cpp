@@ -0,0 +1,89 @@
+#include <Terrain/TerrainOccluders/TerrainOccluders.hpp>
+
+namespace fluorite
+{
+
+    void TerrainOccluders::extract(const TerrainDataBlockSnapshot& snapshot, int cellSize, std::vector<TerrainOccluderBox>& boxes) {
+        boxes.clear();
+        auto cells = snapshot.getSize() / cellSize;
+        auto cellIndex = [&](int x, int y, int z) { return x + cells * (y + cells * z); };
+
+        //Cell covers voxels from c * cellSize to (c + 1) * cellSize inclusive, so it shares a face of voxels with its neighbours
+        std::vector<uint8_t> solid(cells * cells * cells, 0);
+        for(int cz = 0; cz < cells; cz++) {
+            for(int cy = 0; cy < cells; cy++) {
+                for(int cx = 0; cx < cells; cx++) {
+                    auto lo = Vec3Int(cx, cy, cz).mul(cellSize);
+                    auto hi = lo.add(cellSize);
+                    if(!snapshot.contains(hi)) {
+                        continue;
+                    }
+                    bool isSolid = true;
+                    for(int z = lo.z; z <= hi.z && isSolid; z++) {
+                        for(int y = lo.y; y <= hi.y && isSolid; y++) {
+                            auto row = snapshot.getDensityData() + snapshot.getNodeIndex(Vec3Int(lo.x, y, z));
+                            for(int x = 0; x <= cellSize; x++) {
+                                if(row[x] <= 0) {
+                                    isSolid = false;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                    solid[cellIndex(cx, cy, cz)] = isSolid;
+                }
+            }
+        }
+
+        auto isFree = [&](int x, int y, int z) { return solid[cellIndex(x, y, z)] == 1; };
+        auto take = [&](int x, int y, int z) { solid[cellIndex(x, y, z)] = 2; };
+
+        //Greedy merge, every box grows along x, then y, then z as long as whole rows and slices are free
+        for(int z = 0; z < cells; z++) {
+            for(int y = 0; y < cells; y++) {
+                for(int x = 0; x < cells; x++) {
+                    if(!isFree(x, y, z)) {
+                        continue;
+                    }
+                    int ex = x + 1;
+                    while(ex < cells && isFree(ex, y, z)) {
+                        ex++;
+                    }
+                    auto rowFree = [&](int ry, int rz) {
+                        for(int rx = x; rx < ex; rx++) {
+                            if(!isFree(rx, ry, rz)) {
+                                return false;
+                            }
+                        }
+                        return true;
+                    };
+                    int ey = y + 1;
+                    while(ey < cells && rowFree(ey, z)) {
+                        ey++;
+                    }
+                    int ez = z + 1;
+                    while(ez < cells) {
+                        bool sliceFree = true;
+                        for(int ry = y; ry < ey && sliceFree; ry++) {
+                            sliceFree = rowFree(ry, ez);
+                        }
+                        if(!sliceFree) {
+                            break;
+                        }
+                        ez++;
+                    }
+
+                    for(int tz = z; tz < ez; tz++) {
+                        for(int ty = y; ty < ey; ty++) {
+                            for(int tx = x; tx < ex; tx++) {
+                                take(tx, ty, tz);
+                            }
+                        }
+                    }
+                    boxes.push_back({Vec3Int(x, y, z).mul(cellSize), Vec3Int(ex, ey, ez).mul(cellSize)});
+                }
+            }
+        }
+    }
+
+}
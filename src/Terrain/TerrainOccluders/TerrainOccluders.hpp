@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+
+namespace fluorite
+{
+
+    /**
+     * Axis aligned box lying entirely in solid terrain, block local, in voxels of the block's LoD
+     */
+    struct TerrainOccluderBox {
+        Vec3Int lo;
+        Vec3Int hi;
+    };
+
+    /**
+     * Builds conservative occluders of a block for CPU occlusion culling. Block is divided into coarse cells, a cell
+     * whose every voxel is solid(positive density) can't contain any part of the surface, so whatever lies behind it is
+     * hidden. Solid cells are merged greedily into as few boxes as possible, a hill usually ends up as a handful of boxes
+     */
+    class TerrainOccluders {
+        public:
+            /**
+             * @param cellSize edge of coarse cells in voxels, must divide block size. Smaller cells follow the
+             *      surface closer, but give more boxes
+             * @param boxes receives occluders. Cleared first, capacity is reused
+             */
+            static void extract(const TerrainDataBlockSnapshot& snapshot, int cellSize, std::vector<TerrainOccluderBox>& boxes);
+    };
+
+}
@@ -0,0 +1,100 @@
+#include <Terrain/TerrainPrefetch/TerrainPrefetch.hpp>
+
+#include <cmath>
+
+namespace fluorite
+{
+
+    TerrainPrefetchScheduler::TerrainPrefetchScheduler(TerrainDataBlockStorage* storage) : m_storage(storage) {}
+    TerrainPrefetchScheduler::TerrainPrefetchScheduler(TerrainDataBlockStorage* storage, Settings settings) : m_storage(storage), m_settings(settings) {}
+
+    std::vector<TerrainPrefetchScheduler::Request> TerrainPrefetchScheduler::predictPath(Ogre::Vector3 pos, Ogre::Vector3 velocity) {
+        std::map<Vec3Int, float> arrivals;
+
+        auto blockSize = TerrainDataBlock::getBlockSize();
+        auto halfBlock = Ogre::Vector3(blockSize * 0.5f);
+        auto radius = m_settings.pathRadius;
+
+        for(float t = m_settings.sampleStep; t <= m_settings.lookAheadTime; t += m_settings.sampleStep) {
+            auto point = pos + velocity * t;
+
+            auto lo = Vec3Int(std::floor(point.x - radius), std::floor(point.y - radius), std::floor(point.z - radius)).align(blockSize);
+            auto hi = Vec3Int(std::ceil(point.x + radius), std::ceil(point.y + radius), std::ceil(point.z + radius));
+
+            for(int x = lo.x; x <= hi.x; x += blockSize) {
+                for(int y = lo.y; y <= hi.y; y += blockSize) {
+                    for(int z = lo.z; z <= hi.z; z += blockSize) {
+                        auto blockPos = Vec3Int(x, y, z);
+                        auto center = OgreVecFromV3I(blockPos) + halfBlock;
+                        if(center.distance(point) > radius || center.distance(pos) <= m_settings.demandRadius) {
+                            continue;
+                        }
+                        auto arrival = arrivals.find(blockPos);
+                        if(arrival == arrivals.end()) {
+                            arrivals.insert({blockPos, t});
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<Request> result;
+        for(auto& arrival : arrivals) {
+            result.push_back({arrival.first, arrival.second});
+        }
+        std::sort(result.begin(), result.end(), [](auto& a, auto& b){ return a.arrival < b.arrival; });
+        return result;
+    }
+
+    void TerrainPrefetchScheduler::update(Ogre::Vector3 pos, Ogre::Vector3 velocity) {
+        std::vector<Request> path;
+        if(velocity.length() >= m_settings.minSpeed) {
+            path = predictPath(pos, velocity);
+        }
+
+        std::set<Vec3Int> onPath;
+        for(auto& request : path) {
+            onPath.insert(request.blockPos);
+        }
+        for(auto& request : m_queue) {
+            if(onPath.find(request.blockPos) == onPath.end()) {
+                m_stats.cancelled++;
+            }
+        }
+
+        std::set<Vec3Int> wasQueued;
+        for(auto& request : m_queue) {
+            wasQueued.insert(request.blockPos);
+        }
+
+        m_queue.clear();
+        for(auto& request : path) {
+            //Blocks that are already there only have to survive until viewpoint reaches them
+            if(m_storage->getBlockIfExists(request.blockPos)) {
+                m_storage->keepAlive(request.blockPos);
+                continue;
+            }
+            if(wasQueued.find(request.blockPos) == wasQueued.end()) {
+                m_stats.queued++;
+            }
+            m_queue.push_back(request);
+        }
+
+        int budget = std::min<int>(m_settings.maxBlocksPerFrame, m_queue.size());
+        for(int i = 0; i < budget; i++) {
+            m_storage->prefetchBlock(m_queue[i].blockPos);
+        }
+        m_queue.erase(m_queue.begin(), m_queue.begin() + budget);
+    }
+
+    TerrainPrefetchScheduler::Stats TerrainPrefetchScheduler::getStats() {
+        auto result = m_stats;
+        result.storage = m_storage->getPrefetchStats();
+        return result;
+    }
+
+    int TerrainPrefetchScheduler::getQueueSize() {
+        return m_queue.size();
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Terrain/Terrain.hpp>
+#include <set>
+#include <vector>
+
+namespace fluorite
+{
+
+    /**
+     * Generates data blocks ahead of a moving viewpoint. Position is extrapolated along current velocity
+     * and blocks around predicted path are created with a small per-frame budget, nearest in time first.
+     * Everything close to the viewpoint is left to regular requests, so prefetching never competes with them.
+     * Positions and velocity are in terrain voxel units
+     */
+    class TerrainPrefetchScheduler {
+        public:
+            struct Settings {
+                //How far into the future the path is extrapolated, in seconds
+                float lookAheadTime = 1.5f;
+                //Distance in time between sampled points of the path
+                float sampleStep = 0.1f;
+                //Blocks within this radius from every sampled point are prefetched
+                float pathRadius = 48.0f;
+                //Blocks within this radius from the viewpoint are requested anyway, so they are skipped
+                float demandRadius = 48.0f;
+                //Below this speed there is nothing to predict
+                float minSpeed = 1.0f;
+                int maxBlocksPerFrame = 4;
+            };
+
+            struct Stats {
+                int queued = 0;
+                //Requests dropped from the queue because trajectory has changed before they were processed
+                int cancelled = 0;
+                TerrainDataBlockStorage::PrefetchStats storage;
+            };
+
+        private:
+            struct Request {
+                Vec3Int blockPos;
+                //Predicted time until viewpoint reaches the block
+                float arrival;
+            };
+
+            TerrainDataBlockStorage* m_storage;
+            Settings m_settings;
+            std::vector<Request> m_queue;
+            Stats m_stats;
+
+            std::vector<Request> predictPath(Ogre::Vector3 pos, Ogre::Vector3 velocity);
+
+        public:
+            TerrainPrefetchScheduler(TerrainDataBlockStorage* storage);
+            TerrainPrefetchScheduler(TerrainDataBlockStorage* storage, Settings settings);
+
+            /**
+             * Should be called once per frame, after regular block requests
+             */
+            void update(Ogre::Vector3 pos, Ogre::Vector3 velocity);
+
+            Stats getStats();
+            int getQueueSize();
+    };
+
+}
@@ -129,6 +129,14 @@ namespace fluorite
         
             TerrainMap(int _datachunkSize = 256, int _minChunkSize = 16) : datachunkSize(_datachunkSize), minChunkSize(_minChunkSize)
             {}
+
+            int getDatachunkSize() const {
+                return datachunkSize;
+            }
+
+            int getMinChunkSize() const {
+                return minChunkSize;
+            }
         
             void resetInUseFlags() {
                 for(auto& chunk : chunks) {
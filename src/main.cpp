@@ -5,27 +5,41 @@
 #include <SystemServices/SDL2Controller/SDL2Controller.hpp>
 #include <SystemServices/GameloopController/GameloopController.hpp>
 #include <SystemServices/Ogre3d/Ogre3d.hpp>
+#include <SystemServices/Ogre3d/RenderThread/RenderThread.hpp>
 
 #include <Terrain2/Terrain2.hpp>
+#include <Benchmarks/TerrainBenchmarks.hpp>
+#include <Benchmarks/PolygonizerRegression.hpp>
+#include <Benchmarks/FrameBenchmark.hpp>
 
 #include <chrono>
 
 class graphicSubchunkNode : public fluorite::TerrainMap::SubChunkData {
-	std::optional<fluorite::GraphicsObject> graphicsObject;
+	fluorite::RenderThread* renderThread;
+	//0 when node doesn't own an object
+	uint32_t object;
 public:
-	graphicSubchunkNode ( graphicSubchunkNode &&  other) {
-		other.graphicsObject = std::nullopt; 
+	graphicSubchunkNode ( graphicSubchunkNode &&  other) : renderThread(other.renderThread), object(other.object) {
+		other.object = 0; 
+	};
+    graphicSubchunkNode &  operator= ( graphicSubchunkNode && other) {
+		if(object) {
+			renderThread->destroy(object);
+		}
+		renderThread = other.renderThread;
+		object = other.object;
+		other.object = 0;
+		return *this;
 	};
-    graphicSubchunkNode &  operator= ( graphicSubchunkNode && ) = default;
     graphicSubchunkNode ( const graphicSubchunkNode & ) = delete;
     graphicSubchunkNode & operator= ( const graphicSubchunkNode & ) = delete;
    
 	
-	graphicSubchunkNode(const fluorite::GraphicsObject _graphicsObject) : graphicsObject(_graphicsObject) {}
+	graphicSubchunkNode(fluorite::RenderThread* _renderThread, uint32_t _object) : renderThread(_renderThread), object(_object) {}
 
     virtual ~graphicSubchunkNode() {
-		if(graphicsObject.has_value()) {
-			graphicsObject->destroy();
+		if(object) {
+			renderThread->destroy(object);
 		}
 	}
 };
@@ -39,7 +53,12 @@ using std::chrono::milliseconds;
 
 int main(int argc, char ** args) {
 
-	auto terrainMap = fluorite::TerrainMap(1024, 16);
+	int benchmarkResult = 0;
+	if(argc > 1 && (fluorite::TerrainBenchmarks::run(args[1], benchmarkResult)
+		|| fluorite::PolygonizerRegression::run(args[1], argc > 2 ? args[2] : "", benchmarkResult)
+		|| fluorite::FrameBenchmark::run(args[1], argc > 2 ? args[2] : "", benchmarkResult))) {
+		return benchmarkResult;
+	}
 
 	auto gameloopController = fluorite::GameloopController();
 
@@ -48,10 +67,19 @@ int main(int argc, char ** args) {
 	gameloopController.registerEvent(fluorite::GameloopController::PRE_FRAME, [&](fluorite::GameloopController*, float){return sdl2Controller.processInput();});
 
 
+	//Rendering of frame N overlaps simulation of frame N+1, Ogre3d is used only through the render thread
 	auto ogre3d = fluorite::Ogre3d();
-	gameloopController.registerEvent(fluorite::GameloopController::INIT, [&](fluorite::GameloopController*, float){return ogre3d.initOgre(&sdl2Controller);});
-	gameloopController.registerEvent(fluorite::GameloopController::FRAME, [&](fluorite::GameloopController* game, float delta){ogre3d.ogreFrame(delta); return true;});
-	gameloopController.registerEvent(fluorite::GameloopController::SHUTDOWN, [&](fluorite::GameloopController*, float){ogre3d.ogreShutdown(); return true;});
+	fluorite::RenderThread renderThread(&ogre3d);
+	gameloopController.registerEvent(fluorite::GameloopController::INIT, [&](fluorite::GameloopController*, float){return renderThread.start(&sdl2Controller);});
+	gameloopController.registerEvent(fluorite::GameloopController::FRAME, [&](fluorite::GameloopController* game, float delta){renderThread.submitFrame(delta); return true;});
+	gameloopController.registerEvent(fluorite::GameloopController::SHUTDOWN, [&](fluorite::GameloopController*, float){renderThread.stop(); return true;});
+
+	//Subchunks release their objects through renderThread, so the map is destroyed first
+	auto terrainMap = fluorite::TerrainMap(1024, 16);
+	//World units per voxel of the map
+	const float worldScale = 1 / 100.0f;
+	//Render thread starts with the game loop, so the hierarchy is set up before anything is placed
+	ogre3d.getSceneHierarchy().setTerrainLayout(terrainMap.getDatachunkSize(), terrainMap.getMinChunkSize(), worldScale);
 
 	
 	float counter = 0;
@@ -60,12 +88,12 @@ int main(int argc, char ** args) {
 	gameloopController.registerEvent(fluorite::GameloopController::PRE_FRAME, [&](fluorite::GameloopController*, float delta){
 		counter += 0;
 
-		auto cameraPpos = ogre3d.getCamera()->getPos();
+		auto cameraPpos = renderThread.getState().cameraPos;
 		
 
 		terrainMap.resetInUseFlags();
 		auto t1 = high_resolution_clock::now();
-		terrainMap.createChunksForAViewpoint({(int)(cameraPpos.x * 100), 0, (int)(cameraPpos.z * 100)}, 4096);
+		terrainMap.createChunksForAViewpoint({(int)(cameraPpos.x / worldScale), 0, (int)(cameraPpos.z / worldScale)}, 4096);
 		auto t2 = high_resolution_clock::now();
 		terrainMap.clearUnusedChunks();
 		
@@ -81,8 +109,8 @@ int main(int argc, char ** args) {
 
 			auto colorValue = Ogre::ColourValue();
 			colorValue.setHSB(fmod(subchunk->size * 0.17, 1), 0.8f, 0.8f);
-			auto graphicObject = ogre3d.testCube((float)subchunk->pos.x / 100.0f, (float)subchunk->pos.y / 100.0f, (float)subchunk->pos.z / 100.0f, (float)subchunk->size/ 100.0f, colorValue);
-			subchunk->subchunkData.push_back(std::make_shared<graphicSubchunkNode>(graphicObject));
+			auto object = renderThread.createCube(Ogre::Vector3((float)subchunk->pos.x, (float)subchunk->pos.y, (float)subchunk->pos.z) * worldScale, (float)subchunk->size * worldScale, colorValue);
+			subchunk->subchunkData.push_back(std::make_shared<graphicSubchunkNode>(&renderThread, object));
 		});
 		return true;
 	});
@@ -95,6 +123,10 @@ int main(int argc, char ** args) {
 		stream << "Fluorite";
 		stream << " FPS:" << std::fixed << std::setprecision(1) << (1.0f/delta) << ";";
 		stream << " lastop:" << std::fixed << std::setprecision(3) << lastop << ";";
+		auto renderState = renderThread.getState();
+		stream << " render:" << std::fixed << std::setprecision(3) << renderState.timings.renderSeconds * 1000 << ";";
+		stream << " scene:" << std::fixed << std::setprecision(3) << renderState.timings.sceneUpdateSeconds * 1000 << ";";
+		stream << " objects:" << renderState.graphics.objects << ";";
 
 
 		auto text = stream.str();
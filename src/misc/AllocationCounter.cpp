@@ -0,0 +1,50 @@
+#include <misc/AllocationCounter.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace fluorite
+{
+    static std::atomic<int64_t> allocations = 0;
+    static std::atomic<int64_t> deallocations = 0;
+
+    bool AllocationCounter::isEnabled() {
+#ifdef FLUORITE_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    int64_t AllocationCounter::getAllocations() {
+        return allocations;
+    }
+
+    int64_t AllocationCounter::getDeallocations() {
+        return deallocations;
+    }
+}
+
+#ifdef FLUORITE_COUNT_ALLOCATIONS
+
+void* operator new(std::size_t size) {
+    fluorite::allocations++;
+    if(void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    if(ptr) {
+        fluorite::deallocations++;
+        std::free(ptr);
+    }
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+#endif
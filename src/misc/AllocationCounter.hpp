@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace fluorite
+{
+    /**
+     * Counts heap allocations made through global operator new. Counting is compiled in only
+     * with FLUORITE_COUNT_ALLOCATIONS, otherwise all counters stay at 0
+     */
+    struct AllocationCounter {
+        static bool isEnabled();
+        static int64_t getAllocations();
+        static int64_t getDeallocations();
+
+        static int64_t getLiveAllocations() {
+            return getAllocations() - getDeallocations();
+        }
+    };
+}
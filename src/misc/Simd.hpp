@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * FLUORITE_SSE2 is defined when the target has SSE2, intrinsics are available after including this header.
+ * Code using them keeps a scalar path for other targets
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define FLUORITE_SSE2
+#endif